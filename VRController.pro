@@ -32,3 +32,7 @@ SUBDIRS += \
     app \
     controllers
 
+# The benchmarks are only built on demand
+CONFIG(BENCHMARKS) {
+    SUBDIRS += benchmarks
+}
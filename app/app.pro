@@ -95,7 +95,8 @@ HEADERS += \
     src/interfaces/controllerinterface.h \
     src/interfaces/controllercommon.h \
     src/gui/controllerchoicewidget.h \
-    src/core/utility.h
+    src/core/utility.h \
+    src/core/latencystats.h
 
 OTHER_FILES += \
     src/interfaces/ControllerInterface \
@@ -0,0 +1,188 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LATENCYSTATS_H
+#define LATENCYSTATS_H
+
+#include <QString>
+#include <QStringList>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Number of samples used to compute the statistics of a stage
+#define LATENCY_WINDOW_SIZE 1024
+
+// Measure durations with a monotonic clock
+class LatencyTimer
+{
+    public:
+        LatencyTimer() : _start(now()) {}
+
+        // Current time in µs
+        static int64_t now()
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        // Return the elapsed time (in µs) since the creation or the last restart
+        int64_t elapsed() const
+        {
+            return now() - _start;
+        }
+
+        // Return the elapsed time (in µs) and restart the timer
+        int64_t restart()
+        {
+            const int64_t current = now();
+            const int64_t elapsedTime = current - _start;
+            _start = current;
+            return elapsedTime;
+        }
+
+    private:
+        int64_t _start;
+};
+
+struct LatencySummary
+{
+    int samples = 0;
+    // All values are in µs
+    int64_t p50 = 0;
+    int64_t p99 = 0;
+    int64_t max = 0;
+};
+
+// Rolling window of durations for one stage of a pipeline.
+// Samples must be added from a single thread, without any lock.
+// The summary can be computed from any thread, even while samples are added.
+class LatencyStage
+{
+    public:
+        explicit LatencyStage(const QString& name = QString()) : _name(name)
+        {
+            for(int i=0; i < LATENCY_WINDOW_SIZE; ++i)
+                _samples[i].store(0, std::memory_order_relaxed);
+        }
+
+        QString name() const
+        {
+            return _name;
+        }
+
+        void addSample(const int64_t duration)
+        {
+            const uint32_t index = _count.load(std::memory_order_relaxed);
+            _samples[index % LATENCY_WINDOW_SIZE].store(duration, std::memory_order_relaxed);
+            _count.store(index + 1, std::memory_order_release);
+        }
+
+        // Count items that didn't go through the stage (no sample is added)
+        void addSkipped(const uint64_t count = 1)
+        {
+            _skipped.fetch_add(count, std::memory_order_relaxed);
+        }
+
+        uint64_t skipped() const
+        {
+            return _skipped.load(std::memory_order_relaxed);
+        }
+
+        LatencySummary summary() const
+        {
+            LatencySummary summary;
+            const uint32_t count = _count.load(std::memory_order_acquire);
+            summary.samples = std::min<uint32_t>(count, LATENCY_WINDOW_SIZE);
+            if(summary.samples == 0)
+                return summary;
+
+            std::vector<int64_t> values(summary.samples);
+            for(int i=0; i < summary.samples; ++i)
+                values[i] = _samples[i].load(std::memory_order_relaxed);
+
+            std::sort(values.begin(), values.end());
+            summary.p50 = values[(summary.samples - 1) * 50 / 100];
+            summary.p99 = values[(summary.samples - 1) * 99 / 100];
+            summary.max = values.back();
+            return summary;
+        }
+
+        QString report() const
+        {
+            const LatencySummary s = summary();
+            QString text = QStringLiteral("%1: p50=%2 µs, p99=%3 µs, max=%4 µs (%5 samples)")
+                    .arg(_name).arg(s.p50).arg(s.p99).arg(s.max).arg(s.samples);
+            if(skipped() > 0)
+                text += QStringLiteral(", %1 skipped").arg(skipped());
+            return text;
+        }
+
+    private:
+        QString _name;
+        std::atomic<uint32_t> _count{0};
+        std::atomic<uint64_t> _skipped{0};
+        std::atomic<int64_t> _samples[LATENCY_WINDOW_SIZE];
+};
+
+// Group of stages, indexed by an enumeration
+template<int StagesCount>
+class LatencyStats
+{
+    public:
+        explicit LatencyStats(const QStringList& names)
+        {
+            for(int i=0; i < StagesCount; ++i)
+                _stages[i] = new LatencyStage(names.value(i));
+        }
+
+        ~LatencyStats()
+        {
+            for(int i=0; i < StagesCount; ++i)
+                delete _stages[i];
+        }
+
+        LatencyStats(const LatencyStats&) = delete;
+        LatencyStats& operator=(const LatencyStats&) = delete;
+
+        LatencyStage& stage(const int index)
+        {
+            return *_stages[index];
+        }
+
+        void addSample(const int index, const int64_t duration)
+        {
+            _stages[index]->addSample(duration);
+        }
+
+        // One line per stage
+        QString report() const
+        {
+            QStringList lines;
+            for(int i=0; i < StagesCount; ++i)
+                lines.append(_stages[i]->report());
+            return lines.join(QStringLiteral("\n"));
+        }
+
+    private:
+        LatencyStage *_stages[StagesCount];
+};
+
+#endif // LATENCYSTATS_H
@@ -32,15 +32,20 @@
 #include <QProcess>
 #include <QTimer>
 
+#include <algorithm>
 #include <cerrno>
 #include <string>
 
-MainWindow::MainWindow(LogBrowser *logBrowser, bool autoStart, const QString& controllerName, int btPort, int btFreq)
+MainWindow::MainWindow(LogBrowser *logBrowser, bool autoStart, const QString& controllerName, int btPort, int btFreq, bool dataPolling, const QVariantMap& cliControllerOptions):
+    _sendStage(tr("Send")),
+    _sendDelayStage(tr("Send timer delay"))
 {
     setWindowTitle(APPLICATION_NAME);
     setWindowIcon(QIcon(":/icon.png"));
 
     _logBrowser = logBrowser;
+    _dataPolling = dataPolling;
+    _controllerOptions = cliControllerOptions;
     _settings = new QSettings(this);
 
     // Init log browser parents
@@ -74,6 +79,8 @@ MainWindow::MainWindow(LogBrowser *logBrowser, bool autoStart, const QString& co
         if(_controllerPlugin != nullptr)
         {
             _controllerPlugin->setDataFrequency(_listeningWidget->frequency());
+            _controllerPlugin->setDataPolling(_dataPolling);
+            _controllerPlugin->setOptions(controllerOptions(_controllerChoiceWidget->selectedControllerName()));
             _controllerPlugin->start();
             _controllerPlugin->widget()->hide();
             _mainLayout->insertWidget(_mainLayout->count()-1, _controllerPlugin->widget(), 1);
@@ -136,6 +143,10 @@ MainWindow::MainWindow(LogBrowser *logBrowser, bool autoStart, const QString& co
     QMenu *fileMenu = new QMenu(tr("&File"), _menuBar);
     _menuBar->addMenu(fileMenu);
 
+    QAction *statsAction = new QAction(tr("Dump latency &statistics"), this);
+    fileMenu->addAction(statsAction);
+    connect(statsAction, &QAction::triggered, this, &MainWindow::dumpStatistics);
+
     QAction *exitAction = new QAction(tr("&Exit"), this);
     fileMenu->addAction(exitAction);
     connect(exitAction, &QAction::triggered, qApp, &QCoreApplication::quit);
@@ -173,8 +184,21 @@ MainWindow::MainWindow(LogBrowser *logBrowser, bool autoStart, const QString& co
     aboutMenu->addAction(aboutQtAction);
 
     // Connect the signal to start the data timer
+    // If the controller can notify new data, we send them as soon as they are available
+    // (the signal is emitted again on each reconnection, so the data must only be connected once)
     connect(this, &MainWindow::startDataTimer, this, [this]() {
-        _btTimer = startTimer(1000/_listeningWidget->frequency(), Qt::PreciseTimer);
+        _sendTimer.start();
+        if(_controllerPlugin != nullptr && _controllerPlugin->hasDataNotification() && !_dataPolling)
+        {
+            qDebug() << qPrintable(tr("Send data each time the controller has new ones."));
+            connect(_controllerPlugin, &ControllerInterface::dataAvailable, this, &MainWindow::sendData, Qt::UniqueConnection);
+        }
+        else
+        {
+            _sendPeriod = 1000/_listeningWidget->frequency();
+            _lastSendTick = 0;
+            _btTimer = startTimer(_sendPeriod, Qt::PreciseTimer);
+        }
     });
 
 #ifndef NO_BLUETOOTH
@@ -271,60 +295,80 @@ void MainWindow::timerEvent(QTimerEvent *event)
 {
     if(event->timerId() == _btTimer)
     {
-        _numberOfTimerExec++;
-        _numberOfTimerExec2++;
+        // Lateness of the timer, when the GUI thread is busy
+        const int64_t now = LatencyTimer::now();
+        if(_lastSendTick != 0)
+            _sendDelayStage.addSample(std::max<int64_t>(0, now - _lastSendTick - _sendPeriod * 1000));
+        _lastSendTick = now;
+        sendData();
+    }
+}
+
+void MainWindow::sendData()
+{
 #ifndef NO_BLUETOOTH
-        if(_btMgr == nullptr)
-        {
-            qCritical() << qPrintable(tr("The bluetooth manager is not created !"));
-            return;
-        }
+    if(_btMgr == nullptr)
+    {
+        qCritical() << qPrintable(tr("The bluetooth manager is not created !"));
+        return;
+    }
 #endif
-        if(_controllerPlugin == nullptr)
-        {
-            qCritical() << qPrintable(tr("The controller is not created !"));
-            return;
-        }
+    if(_controllerPlugin == nullptr)
+    {
+        qCritical() << qPrintable(tr("The controller is not created !"));
+        return;
+    }
+
+    const qint64 elapsed = _sendTimer.elapsed();
+    LatencyTimer latencyTimer;
 
-        const int walkSpeed = _controllerPlugin->walkSpeed();
-        const int orientation = _controllerPlugin->orientation();
-        int specialCode = _controllerPlugin->specialCode();
+    const int walkSpeed = _controllerPlugin->walkSpeed();
+    const int orientation = _controllerPlugin->orientation();
+    int specialCode = _controllerPlugin->specialCode();
 
-        // Only send if an orientation and a walkSpeed is detected
-        if(orientation == -1 || walkSpeed == -1 || specialCode < 0)
-            return;
+    // Only send if an orientation and a walkSpeed is detected
+    if(orientation == -1 || walkSpeed == -1 || specialCode < 0)
+        return;
 
+    // Use the elapsed time since data may not be sent at a fixed frequency
+    if(!_gameStarted)
+    {
         // Before 3 seconds
-        if(_numberOfTimerExec2 < _listeningWidget->frequency() * 3)
+        if(elapsed < 3000)
             specialCode = 1;
         // At 3 seconds, it's the start
-        else if(_numberOfTimerExec2 == _listeningWidget->frequency() * 3)
+        else
+        {
             specialCode = 3;
+            _gameStarted = true;
+        }
+    }
 
-        // The message contains 4 numbers
-        // First:  0xFF --> specify that the message begins
-        // Second: Walk speed, a number between 0 and 254
-        // Third:  Orientation, a number between 0 and 254 (a ratio with the originally 0-360 range)
-        // Fourth: Special code, a number used to send special commands to the game
-        std::uint8_t msg[4];
+    // The message contains 4 numbers
+    // First:  0xFF --> specify that the message begins
+    // Second: Walk speed, a number between 0 and 254
+    // Third:  Orientation, a number between 0 and 254 (a ratio with the originally 0-360 range)
+    // Fourth: Special code, a number used to send special commands to the game
+    std::uint8_t msg[4];
 
-        msg[0] = 0xFF;
-        msg[1] = walkSpeed;
-        msg[2] = orientation * ORIENTATION_DECREASE_RATIO;
-        msg[3] = specialCode;
+    msg[0] = 0xFF;
+    msg[1] = walkSpeed;
+    msg[2] = orientation * ORIENTATION_DECREASE_RATIO;
+    msg[3] = specialCode;
 
-        // Show the debug message only one time per second
-        if(_numberOfTimerExec == _listeningWidget->frequency())
-        {
-            // Don't show debug message if all data equals 0
-            if(walkSpeed != 0 || orientation != 0)
-                qDebug() << qPrintable(tr("Send message: speed=%1 orientation=%2 (real orientation: %3)").arg((int)msg[1]).arg((int)msg[2]).arg(orientation));
-            _numberOfTimerExec = 0;
-        }
+    // Show the debug message only one time per second
+    if(elapsed - _lastSendDebugTime >= 1000)
+    {
+        // Don't show debug message if all data equals 0
+        if(walkSpeed != 0 || orientation != 0)
+            qDebug() << qPrintable(tr("Send message: speed=%1 orientation=%2 (real orientation: %3)").arg((int)msg[1]).arg((int)msg[2]).arg(orientation));
+        _lastSendDebugTime = elapsed;
+    }
 #ifndef NO_BLUETOOTH
-        _btMgr->sendMessage(&msg, 4);
+    _btMgr->sendMessage(&msg, 4);
 #endif
-    }
+    _controllerPlugin->dataSent();
+    _sendStage.addSample(latencyTimer.elapsed());
 }
 
 void MainWindow::closeEvent(QCloseEvent *event)
@@ -334,6 +378,20 @@ void MainWindow::closeEvent(QCloseEvent *event)
 }
 
 // Public slots
+void MainWindow::dumpStatistics()
+{
+    qDebug() << qPrintable(tr("Latency statistics:"));
+    qDebug() << qPrintable(_sendStage.report());
+    if(_btTimer != 0)
+        qDebug() << qPrintable(_sendDelayStage.report());
+    if(_controllerPlugin != nullptr)
+    {
+        const QStringList lines = _controllerPlugin->statistics().split(QStringLiteral("\n"), QString::SkipEmptyParts);
+        for(const QString& line : lines)
+            qDebug() << qPrintable(line);
+    }
+}
+
 void MainWindow::about()
 {
     AboutDialog *dialog = new AboutDialog(_controllerChoiceWidget->thirdPartiesLicensesFromPlugins(), this);
@@ -406,3 +464,19 @@ void MainWindow::writeSettings()
     _settings->endGroup();
 }
 
+QVariantMap MainWindow::controllerOptions(const QString& controllerName)
+{
+    QVariantMap options;
+
+    _settings->beginGroup(settingControllerOptsGroup);
+    _settings->beginGroup(controllerName);
+    for(const QString& key : _settings->childKeys())
+        options.insert(key, _settings->value(key));
+    _settings->endGroup();
+    _settings->endGroup();
+
+    for(auto it = _controllerOptions.constBegin(); it != _controllerOptions.constEnd(); ++it)
+        options.insert(it.key(), it.value());
+
+    return options;
+}
@@ -27,6 +27,7 @@
 #include <QMenuBar>
 #include <QSettings>
 #include <QDockWidget>
+#include <QElapsedTimer>
 
 #include "listeningwidget.h"
 #include "controllerchoicewidget.h"
@@ -34,6 +35,7 @@
 #include "../core/bluetoothmanager.h"
 #endif
 #include "log/logbrowser.h"
+#include "../core/latencystats.h"
 
 #define DEFAULT_MSG_FREQUENCY 10
 
@@ -42,13 +44,19 @@ class MainWindow : public QMainWindow
         Q_OBJECT
 
     public:
-        MainWindow(LogBrowser* logBrowser, bool autoStart, const QString& controllerName, int btPort, int btFreq);
+        MainWindow(LogBrowser* logBrowser, bool autoStart, const QString& controllerName, int btPort, int btFreq, bool dataPolling, const QVariantMap& cliControllerOptions);
 
     public slots:
 
         void about();
         void setConnectionAddress(const QString addr, const int channel);
 
+        // Output the latency statistics of the program and of the controller in the log
+        void dumpStatistics();
+
+        // Send the current data of the controller to the BT device
+        void sendData();
+
     signals:
         //
         // This signals allow the application to manipulate the widgets from an another thread
@@ -72,6 +80,10 @@ class MainWindow : public QMainWindow
         void writeSettings();
         void readSettings();
 
+        // Options of the controller stored in the settings,
+        // overridden by the ones given in the command line
+        QVariantMap controllerOptions(const QString& controllerName);
+
     private:
         QWidget *_centralWidget;
 
@@ -84,7 +96,7 @@ class MainWindow : public QMainWindow
         LogBrowser *_logBrowser;
         QDockWidget *_logDock;
 
-        ControllerInterface *_controllerPlugin;
+        ControllerInterface *_controllerPlugin = nullptr;
 
         QStatusBar *_statusBar;
         // Widgets used in the status bar
@@ -100,9 +112,25 @@ class MainWindow : public QMainWindow
         std::function<void(BluetoothManager::Error)> _btMgrErrorHandler;
 #endif
         int _btTimer = 0;
-        // These variables is used to count the number of executions of the method timerEvent()
-        int _numberOfTimerExec = 0;
-        int _numberOfTimerExec2 = 0;
+        // If false, data are sent when the controller notifies them (if supported)
+        bool _dataPolling = false;
+        // Options given in the command line
+        QVariantMap _controllerOptions;
+
+        // Time since the first data was sent
+        QElapsedTimer _sendTimer;
+        // Time of the last debug message (in ms, relative to _sendTimer)
+        qint64 _lastSendDebugTime = 0;
+        bool _gameStarted = false;
+
+        // Time taken to read the controller data and send them
+        LatencyStage _sendStage;
+        // Time between the expected and the actual ticks of the data timer
+        LatencyStage _sendDelayStage;
+        // Period of the data timer (in ms)
+        int _sendPeriod = 0;
+        // Time of the last tick (in µs, see LatencyTimer)
+        int64_t _lastSendTick = 0;
 
         QSettings *_settings;
 };
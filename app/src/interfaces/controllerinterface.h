@@ -25,6 +25,8 @@
 #include <QMap>
 #include <QPluginLoader>
 #include <QVariant>
+#include <QVariantMap>
+#include <QList>
 
 // Implements a basic interface used by all controllers.
 class ControllerInterface: public QObject
@@ -33,9 +35,19 @@ class ControllerInterface: public QObject
         // This property is usually set by the program.
         // Used to know the frequency of data send with bluetooth
         Q_PROPERTY(unsigned int dataFrequency READ dataFrequency WRITE setDataFrequency)
+        // This property is usually set by the program.
+        // When true, the data are read at the data frequency even if the controller
+        // is able to notify new data (see hasDataNotification())
+        Q_PROPERTY(bool dataPolling READ dataPolling WRITE setDataPolling)
+        // This property is usually set by the program, before start() is called.
+        // Contains the options specific to this controller (read from the settings
+        // and from the command line)
+        Q_PROPERTY(QVariantMap options READ options WRITE setOptions)
 
     private:
         unsigned int _dataFrenquency = 1;
+        bool _dataPolling = false;
+        QVariantMap _options;
 
     public:
 
@@ -63,16 +75,80 @@ class ControllerInterface: public QObject
         // - 3: start the game !
         virtual int specialCode() = 0;
 
+        // Return the IDs of all users currently seen by the controller.
+        // Controllers that don't distinguish users return an empty list.
+        virtual QList<int> userIDs()
+        {
+            return QList<int>();
+        }
+
+        // Select the user used by orientation(), walkSpeed() and specialCode().
+        // 0 selects the first available user.
+        // Return false if the controller doesn't support user selection.
+        virtual bool selectUser(const int /*id*/)
+        {
+            return false;
+        }
+
+        // Return a human readable report of the internal statistics of the controller
+        // (for example the latencies of each processing stage)
+        virtual QString statistics()
+        {
+            return QString();
+        }
+
+        // Called each time the values read from orientation(), walkSpeed() and specialCode()
+        // were sent, so the controller can measure the age of the sent data
+        virtual void dataSent()
+        {
+        }
+
+        // Return true if the controller emits dataAvailable() each time new data are ready.
+        // If false, the program reads the data at the data frequency.
+        virtual bool hasDataNotification() const
+        {
+            return false;
+        }
+
         unsigned int dataFrequency() const
         {
             return _dataFrenquency;
         }
 
+        bool dataPolling() const
+        {
+            return _dataPolling;
+        }
+
+        QVariantMap options() const
+        {
+            return _options;
+        }
+
+        QVariant option(const QString& key, const QVariant& defaultValue = QVariant()) const
+        {
+            return _options.value(key, defaultValue);
+        }
+
+    signals:
+        // Emitted when new data are ready (only if hasDataNotification() returns true)
+        void dataAvailable();
+
     public slots:
         void setDataFrequency(unsigned int frequency)
         {
             _dataFrenquency = frequency;
         }
+
+        void setDataPolling(bool polling)
+        {
+            _dataPolling = polling;
+        }
+
+        void setOptions(const QVariantMap& options)
+        {
+            _options = options;
+        }
 };
 
 #define ControllerInterface_iid "vrcontroller.controllerinterface"
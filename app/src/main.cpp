@@ -31,6 +31,7 @@
 #include <QCommandLineOption>
 #include <QString>
 #include <QStringList>
+#include <QVariantMap>
 
 LogBrowser *globalLogBrowser;
 
@@ -177,6 +178,8 @@ int main(int argc, char *argv[])
     parser.addOption(QCommandLineOption({"c", "controller"}, QCoreApplication::translate("options", "The controller <controller-name> will be used."), QCoreApplication::translate("options", "controller-name")));
     parser.addOption(QCommandLineOption({"p", "port"}, QCoreApplication::translate("options", "The Bluetooth engine will listen on the specified <port-number>. The <port-number> must be in range 1-30. Set to 0 if you want to select the first available."), QCoreApplication::translate("options", "port-number")));
     parser.addOption(QCommandLineOption({"f", "frequency"}, QCoreApplication::translate("options", "Frequency for emitting data to the bluetooth device (number of data per second)"), QCoreApplication::translate("options", "number-per-second")));
+    parser.addOption(QCommandLineOption("polling", QCoreApplication::translate("options", "Read the controller data at the specified frequency, even if the controller can notify new data.")));
+    parser.addOption(QCommandLineOption({"o", "option"}, QCoreApplication::translate("options", "Set an option of the controller (overrides the value stored in the settings). Can be used multiple times."), QCoreApplication::translate("options", "key=value")));
     parser.addOption(QCommandLineOption("nologwidget", QCoreApplication::translate("options", "Don't show the log console in the bottom of the window.")));
 
     parser.process(app);
@@ -185,7 +188,18 @@ int main(int argc, char *argv[])
     if(useLogWidget)
         globalLogBrowser = new LogBrowser();
 
-    MainWindow window(globalLogBrowser, parser.isSet("auto-start"), parser.value("controller"), intFromParser(parser, "port"), intFromParser(parser, "frequency"));
+    // Controller options, given as key=value
+    QVariantMap controllerOptions;
+    for(const QString& option : parser.values("option"))
+    {
+        const int separator = option.indexOf('=');
+        if(separator <= 0)
+            qWarning() << qPrintable(QCoreApplication::tr("Invalid controller option: %1 (must be key=value)").arg(option));
+        else
+            controllerOptions.insert(option.left(separator), option.mid(separator + 1));
+    }
+
+    MainWindow window(globalLogBrowser, parser.isSet("auto-start"), parser.value("controller"), intFromParser(parser, "port"), intFromParser(parser, "frequency"), parser.isSet("polling"), controllerOptions);
     window.show();
 
     // Execute the main loop
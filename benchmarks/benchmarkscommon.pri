@@ -0,0 +1,48 @@
+#############################################################################
+##
+## This file is part of VRController.
+## Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+##
+## This file is free software: you can redistribute it and/or modify
+## it under the terms of the GNU General Public License as published by
+## the Free Software Foundation, either version 3 of the License, or
+## (at your option) any later version.
+##
+## This file is distributed in the hope that it will be useful,
+## but WITHOUT ANY WARRANTY; without even the implied warranty of
+## MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+## GNU General Public License for more details.
+##
+## You should have received a copy of the GNU General Public License
+## along with this program.  If not, see <http://www.gnu.org/licenses/>.
+##
+#############################################################################
+
+# Benchmarks common configuration file #
+
+#
+# The benchmark must define this variable :
+# - BENCHMARK_NAME (the name used for this benchmark in lower letters)
+#
+
+# Console application without Qt, always optimized
+TEMPLATE = app
+CONFIG += console c++11 thread release warn_on
+CONFIG -= app_bundle qt debug
+
+TARGET = $${BENCHMARK_NAME}
+
+BUILD_PATH = build
+BIN_PATH = $$PWD/bin
+
+OBJECTS_DIR = $${BUILD_PATH}/obj
+DESTDIR = $${BIN_PATH}
+
+# Sources of the OpenNI controller measured by the benchmarks
+OPENNICONTROLLER_SRC = $$PWD/../controllers/opennicontroller/src
+
+INCLUDEPATH += \
+    $$OPENNICONTROLLER_SRC
+
+DEPENDPATH += \
+    $$OPENNICONTROLLER_SRC
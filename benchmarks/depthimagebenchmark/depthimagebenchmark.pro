@@ -0,0 +1,40 @@
+#############################################################################
+##
+## This file is part of VRController.
+## Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+##
+## This file is free software: you can redistribute it and/or modify
+## it under the terms of the GNU General Public License as published by
+## the Free Software Foundation, either version 3 of the License, or
+## (at your option) any later version.
+##
+## This file is distributed in the hope that it will be useful,
+## but WITHOUT ANY WARRANTY; without even the implied warranty of
+## MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+## GNU General Public License for more details.
+##
+## You should have received a copy of the GNU General Public License
+## along with this program.  If not, see <http://www.gnu.org/licenses/>.
+##
+#############################################################################
+
+##########################################################
+# Scalar against AVX2 conversion of the depth map colors #
+##########################################################
+
+BENCHMARK_NAME = depthimagebenchmark
+include($$PWD/../benchmarkscommon.pri)
+
+# Only the OpenNI headers are needed (for XnDepthPixel)
+INCLUDEPATH += /usr/include/ni
+DEFINES += linux
+linux-g++-32|linux-g++:!contains($$system(uname -m), x86_64) {
+    DEFINES += i386
+}
+
+SOURCES += \
+    main.cpp \
+    $${OPENNICONTROLLER_SRC}/depthimage.cpp
+
+HEADERS += \
+    $${OPENNICONTROLLER_SRC}/depthimage.h
@@ -0,0 +1,166 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Compare the scalar and AVX2 kernels of DepthImage::depthToColors() on a 640x480 depth map,
+// then measure drawDepthMap() with the kernels selected at runtime (as in the GUI)
+// against the per-pixel loop it replaced in OpenCVUtil::drawDepthMap().
+// The kernels must give the same colors, the benchmark fails otherwise.
+
+#include "depthimage.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#define DEPTH_WIDTH 640
+#define DEPTH_HEIGHT 480
+
+// Ratio of the previous gray conversion
+// Use 10000 in the ratio since we don't want to see after 10 meters
+#define DEPTH_IMAGE_RATIO (256.0f / 10000.0f)
+
+namespace
+{
+    // A floor, a wall and some holes (pixels without depth) like the sensor gives
+    std::vector<XnDepthPixel> makeDepthMap()
+    {
+        std::vector<XnDepthPixel> depthMap(DEPTH_WIDTH * DEPTH_HEIGHT);
+        std::mt19937 random(42);
+        std::uniform_int_distribution<int> noise(-20, 20);
+        std::uniform_int_distribution<int> hole(0, 99);
+
+        for(int y=0; y < DEPTH_HEIGHT; ++y)
+        {
+            for(int x=0; x < DEPTH_WIDTH; ++x)
+            {
+                int depth = y < DEPTH_HEIGHT / 2 ? 3500 : 800 + (DEPTH_HEIGHT - y) * 10;
+                depth += noise(random);
+                depthMap[y * DEPTH_WIDTH + x] = hole(random) < 5 ? 0 : static_cast<XnDepthPixel>(depth);
+            }
+        }
+        return depthMap;
+    }
+
+    // Previous OpenCVUtil::drawDepthMap(): one float multiply per depth pixel and each byte
+    // of the res x res square written separately in a BGR image of cols pixels per row
+    void referenceDrawDepthMap(uint8_t *pixelPtr, const int cols, const XnDepthPixel* depthMap,
+                               const int width, const int height, const int startX, const int startY, const int res)
+    {
+        const int depthMapWidth = width * res;
+        const int depthMapHeight = height * res;
+
+        const XnDepthPixel* depthData = depthMap;
+
+        for(int r=startY; r < startY + depthMapHeight; r += res)
+        {
+            for(int c=startX; c < startX + depthMapWidth; c += res)
+            {
+                const uint16_t realColor = (*depthData) * DEPTH_IMAGE_RATIO;
+                const uint8_t color = realColor > UINT8_MAX ? UINT8_MAX : realColor;
+
+                for(int i=0; i < res; ++i)
+                {
+                    for(int j=0; j < res; ++j)
+                    {
+                        pixelPtr[(r+i)*cols*3 + (c+j)*3] = color;
+                        pixelPtr[(r+i)*cols*3 + (c+j)*3 + 1] = color;
+                        pixelPtr[(r+i)*cols*3 + (c+j)*3 + 2] = color;
+                    }
+                }
+                depthData++;
+            }
+        }
+    }
+
+    // Return the average time of a call (in µs)
+    template<typename Function>
+    double measure(const int iterations, Function function)
+    {
+        // Warm up the caches
+        for(int i=0; i < 10; ++i)
+            function();
+
+        const auto begin = std::chrono::steady_clock::now();
+        for(int i=0; i < iterations; ++i)
+            function();
+        const auto elapsed = std::chrono::steady_clock::now() - begin;
+
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / 1000.0 / iterations;
+    }
+}
+
+// Usage: depthimagebenchmark [iterations]
+int main(int argc, char *argv[])
+{
+    const int iterations = argc > 1 ? std::max(1, std::atoi(argv[1])) : 500;
+    const int count = DEPTH_WIDTH * DEPTH_HEIGHT;
+
+    const std::vector<XnDepthPixel> depthMap = makeDepthMap();
+    DepthColorTable table;
+    table.setPalette(DepthPalette::Turbo, 500, 4500);
+
+    std::vector<uint32_t> scalarColors(count);
+    std::vector<uint32_t> avx2Colors(count);
+
+    const double scalarTime = measure(iterations, [&]() {
+        DepthImage::depthToColorsWith(DepthImage::Kernel::Scalar, depthMap.data(), scalarColors.data(), count, table);
+    });
+    std::printf("depthToColors scalar: %8.1f us per frame\n", scalarTime);
+
+    bool failed = false;
+    if(DepthImage::depthToColorsWith(DepthImage::Kernel::AVX2, depthMap.data(), avx2Colors.data(), count, table))
+    {
+        const double avx2Time = measure(iterations, [&]() {
+            DepthImage::depthToColorsWith(DepthImage::Kernel::AVX2, depthMap.data(), avx2Colors.data(), count, table);
+        });
+        std::printf("depthToColors AVX2:   %8.1f us per frame (x%.1f)\n", avx2Time, scalarTime / avx2Time);
+
+        if(avx2Colors != scalarColors)
+        {
+            std::printf("The AVX2 kernel doesn't give the same colors as the scalar one !\n");
+            failed = true;
+        }
+    }
+    else
+        std::printf("depthToColors AVX2:   not supported by this CPU\n");
+
+    // The GUI draws the depth map with a resolution of 2
+    for(const int res : {1, 2})
+    {
+        const size_t step = static_cast<size_t>(DEPTH_WIDTH) * res * sizeof(uint32_t);
+        std::vector<uint8_t> image(step * DEPTH_HEIGHT * res);
+
+        const double drawTime = measure(iterations, [&]() {
+            DepthImage::drawDepthMap(image.data(), step, depthMap.data(), DEPTH_WIDTH, DEPTH_HEIGHT, res, table);
+        });
+
+        std::vector<uint8_t> referenceImage(static_cast<size_t>(DEPTH_WIDTH) * res * DEPTH_HEIGHT * res * 3);
+        const double referenceTime = measure(iterations, [&]() {
+            referenceDrawDepthMap(referenceImage.data(), DEPTH_WIDTH * res, depthMap.data(), DEPTH_WIDTH, DEPTH_HEIGHT, 0, 0, res);
+        });
+
+        std::printf("drawDepthMap res %d: previous loop %8.1f us, %s %8.1f us per frame (x%.1f)\n",
+                    res, referenceTime, DepthImage::kernelName(), drawTime, referenceTime / drawTime);
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,182 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Compare the SeqLock publishing the camera informations with the mutex it replaced.
+// One writer thread stores snapshots as fast as possible while reader threads load them,
+// like the frame loop against the GUI and Bluetooth timers but without any pause.
+// The average and worst store times are measured on the writer (including the clock reads).
+// Each reader checks that the snapshots it gets are never torn.
+
+#include "seqlock.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // About the size of OpenNIUtil::CameraInformations (which needs the OpenNI headers)
+    struct Snapshot
+    {
+        uint64_t counter;
+        float values[150];
+    };
+
+    Snapshot makeSnapshot(const uint64_t counter)
+    {
+        Snapshot snapshot;
+        snapshot.counter = counter;
+        for(float& value : snapshot.values)
+            value = static_cast<float>(counter);
+        return snapshot;
+    }
+
+    bool isConsistent(const Snapshot& snapshot)
+    {
+        const float expected = static_cast<float>(snapshot.counter);
+        for(const float value : snapshot.values)
+        {
+            if(value != expected)
+                return false;
+        }
+        return true;
+    }
+
+    // Same interface as SeqLock, protected by a mutex (the previous implementation)
+    class MutexSnapshot
+    {
+        public:
+            void store(const Snapshot& value)
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _data = value;
+            }
+
+            Snapshot load() const
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                return _data;
+            }
+
+        private:
+            mutable std::mutex _mutex;
+            Snapshot _data = Snapshot();
+    };
+
+    struct Result
+    {
+        double nsPerStore;
+        double maxStoreUs;
+        double nsPerLoad;
+        uint64_t torn;
+    };
+
+    template<typename Container>
+    Result run(const unsigned int readerCount, const std::chrono::milliseconds duration)
+    {
+        Container container;
+        container.store(makeSnapshot(0));
+
+        std::atomic<bool> running{true};
+        std::atomic<uint64_t> loads{0};
+        std::atomic<uint64_t> torn{0};
+        uint64_t stores = 0;
+
+        std::vector<std::thread> readers;
+        for(unsigned int i = 0; i < readerCount; ++i)
+        {
+            readers.emplace_back([&]()
+            {
+                uint64_t localLoads = 0;
+                uint64_t localTorn = 0;
+                while(running.load(std::memory_order_relaxed))
+                {
+                    if(!isConsistent(container.load()))
+                        ++localTorn;
+                    ++localLoads;
+                }
+                loads += localLoads;
+                torn += localTorn;
+            });
+        }
+
+        // The worst store is the longest stall the frame loop could get from the readers
+        std::chrono::steady_clock::duration maxStore(0);
+
+        const auto begin = std::chrono::steady_clock::now();
+        const auto end = begin + duration;
+        auto now = begin;
+        while(now < end)
+        {
+            const Snapshot snapshot = makeSnapshot(++stores);
+            container.store(snapshot);
+
+            const auto previous = now;
+            now = std::chrono::steady_clock::now();
+            if(now - previous > maxStore)
+                maxStore = now - previous;
+        }
+        running = false;
+        const auto elapsed = now - begin;
+
+        for(std::thread& reader : readers)
+            reader.join();
+
+        const double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+
+        Result result;
+        result.nsPerStore = ns / static_cast<double>(stores);
+        result.maxStoreUs = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(maxStore).count()) / 1000.0;
+        // Each reader runs for the whole duration
+        result.nsPerLoad = loads > 0 ? ns * readerCount / static_cast<double>(loads.load()) : 0.0;
+        result.torn = torn;
+        return result;
+    }
+
+    void printResult(const char *name, const unsigned int readerCount, const Result& result)
+    {
+        std::printf("%-8s readers=%u  store: %8.1f ns (max %8.1f us)  load: %8.1f ns  torn: %llu\n",
+                    name, readerCount, result.nsPerStore, result.maxStoreUs, result.nsPerLoad,
+                    static_cast<unsigned long long>(result.torn));
+    }
+}
+
+// Usage: seqlockbenchmark [duration in ms per run]
+int main(int argc, char *argv[])
+{
+    const std::chrono::milliseconds duration(argc > 1 ? std::atoi(argv[1]) : 1000);
+
+    bool failed = false;
+    for(const unsigned int readerCount : {1u, 2u, 4u})
+    {
+        const Result seqLock = run<SeqLock<Snapshot>>(readerCount, duration);
+        const Result mutex = run<MutexSnapshot>(readerCount, duration);
+
+        printResult("seqlock", readerCount, seqLock);
+        printResult("mutex", readerCount, mutex);
+
+        failed = failed || seqLock.torn > 0 || mutex.torn > 0;
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
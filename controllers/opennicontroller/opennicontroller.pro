@@ -51,7 +51,22 @@ SOURCES += \
     src/opencvutil.cpp \
     src/opencvwidget.cpp \
     src/openniapplication.cpp \
-    src/openniworker.cpp
+    src/openniworker.cpp \
+    src/depthframepool.cpp \
+    src/poseextractor.cpp \
+    src/usertable.cpp \
+    src/sessionrecorder.cpp \
+    src/sessionreader.cpp \
+    src/opennisensorsource.cpp \
+    src/replaysensorsource.cpp \
+    src/usbdevices.cpp \
+    src/usbcommandqueue.cpp \
+    src/autotiltcontroller.cpp \
+    src/posefilter.cpp \
+    src/motionpredictor.cpp \
+    src/depthimage.cpp \
+    src/hudrenderer.cpp \
+    src/renderworker.cpp
 
 HEADERS += \
     src/opennicontrollerwidget.h \
@@ -60,7 +75,28 @@ HEADERS += \
     src/openniutil.h \
     src/usbcontroller.h \
     src/openniapplication.h \
-    src/openniworker.h
+    src/openniworker.h \
+    src/seqlock.h \
+    src/depthframepool.h \
+    src/poseextractor.h \
+    src/usertable.h \
+    src/spscqueue.h \
+    src/sessionformat.h \
+    src/sessionrecorder.h \
+    src/sessionreader.h \
+    src/sensorsource.h \
+    src/opennisensorsource.h \
+    src/replaysensorsource.h \
+    src/usbdevices.h \
+    src/usbcommandqueue.h \
+    src/pipelinequeue.h \
+    src/autotiltcontroller.h \
+    src/posefilter.h \
+    src/motionpredictor.h \
+    src/depthimage.h \
+    src/hudrenderer.h \
+    src/renderworker.h \
+    $${APP_PATH}/src/core/latencystats.h
 
 # French translation
 TRANSLATIONS += \
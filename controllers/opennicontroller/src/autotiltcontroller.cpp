@@ -0,0 +1,114 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "autotiltcontroller.h"
+
+#include <algorithm>
+#include <cmath>
+
+AutoTiltController::AutoTiltController()
+{
+}
+
+void AutoTiltController::setAngle(const int angle)
+{
+    _angle = angle;
+}
+
+int AutoTiltController::angle() const
+{
+    return _angle;
+}
+
+void AutoTiltController::reset()
+{
+    _correcting = false;
+    _lastCommandTime = -1;
+}
+
+bool AutoTiltController::update(const OpenNIUtil::CameraInformations& camInfo)
+{
+    const OpenNIUtil::User& user = camInfo.user;
+    if(camInfo.invalid || !user.isTracking || !OpenNIUtil::isJointAcceptable(user.torsoJoint))
+        return false;
+
+    // The sensor clock restarts when the source is re-initialized (stall or hot-plug)
+    if(_lastCommandTime != -1 && camInfo.sensorTimestamp < _lastCommandTime)
+        reset();
+
+    // Let the motor move before looking at the image again
+    if(_lastCommandTime != -1 && camInfo.sensorTimestamp - _lastCommandTime < AUTO_TILT_INTERVAL * 1000)
+        return false;
+
+    const OpenNIUtil::Joint *shoulder = nullptr;
+    if(OpenNIUtil::isJointAcceptable(user.leftPart.shoulder))
+        shoulder = &user.leftPart.shoulder;
+    else if(OpenNIUtil::isJointAcceptable(user.rightPart.shoulder))
+        shoulder = &user.rightPart.shoulder;
+
+    const OpenNIUtil::Joint *foot = nullptr;
+    if(OpenNIUtil::isJointAcceptable(user.leftPart.foot))
+        foot = &user.leftPart.foot;
+    else if(OpenNIUtil::isJointAcceptable(user.rightPart.foot))
+        foot = &user.rightPart.foot;
+
+    // In degrees, positive to tilt up
+    float correction = 0.0f;
+    if(shoulder != nullptr && foot == nullptr)
+    {
+        // The feet left the bottom of the image
+        correction = -AUTO_TILT_MAX_STEP;
+        _correcting = false;
+    }
+    else if(shoulder == nullptr && foot != nullptr)
+    {
+        // The shoulders left the top of the image
+        correction = AUTO_TILT_MAX_STEP;
+        _correcting = false;
+    }
+    else
+    {
+        const float centerY = (shoulder != nullptr && foot != nullptr)
+                ? (shoulder->projectivePos.Y + foot->projectivePos.Y) / 2.0f
+                : user.torsoJoint.projectivePos.Y;
+
+        // The Y axis of the image goes down
+        const float error = (camInfo.depthHeight / 2.0f - centerY) / camInfo.depthHeight;
+
+        // Hysteresis: don't move for small offsets, but center the user once moving
+        if(std::abs(error) > AUTO_TILT_OUTER_BAND)
+            _correcting = true;
+        else if(std::abs(error) < AUTO_TILT_INNER_BAND)
+            _correcting = false;
+
+        if(!_correcting)
+            return false;
+
+        correction = std::max(-static_cast<float>(AUTO_TILT_MAX_STEP),
+                              std::min(static_cast<float>(AUTO_TILT_MAX_STEP), error * DEPTH_VERTICAL_FOV));
+    }
+
+    const int current = _angle;
+    const int target = std::max(MIN_TILT_ANGLE, std::min(MAX_TILT_ANGLE, current + static_cast<int>(std::lround(correction))));
+    if(target == current)
+        return false;
+
+    _angle = target;
+    _lastCommandTime = camInfo.sensorTimestamp;
+    return true;
+}
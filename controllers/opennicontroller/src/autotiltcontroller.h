@@ -0,0 +1,70 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AUTOTILTCONTROLLER_H
+#define AUTOTILTCONTROLLER_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "openniutil.h"
+
+// Limits of the Kinect motor (in degrees)
+#define MIN_TILT_ANGLE -27
+#define MAX_TILT_ANGLE 27
+// Vertical field of view of the depth camera (in degrees)
+#define DEPTH_VERTICAL_FOV 43.0f
+
+// Minimum time between two motor commands (in ms), the image moves meanwhile
+#define AUTO_TILT_INTERVAL 400
+// Maximum angle change per command (in degrees)
+#define AUTO_TILT_MAX_STEP 6
+// A correction starts when the body center is further than this from the image center
+// and stops when it is closer than the inner band (ratios of the image height)
+#define AUTO_TILT_OUTER_BAND 0.15f
+#define AUTO_TILT_INNER_BAND 0.05f
+
+// Closed-loop tilt control keeping the selected user in the middle of the image.
+// The center of the body (between the shoulders and the feet) is used when
+// visible, otherwise the sensor is tilted toward the missing joints.
+class AutoTiltController
+{
+    public:
+        AutoTiltController();
+
+        // Current motor angle, must be called when the motor is moved manually
+        // Can be called from any thread
+        void setAngle(const int angle);
+        int angle() const;
+
+        // Forget the running correction
+        void reset();
+
+        // Return true if the motor must be moved to angle()
+        // Must be called for each frame, from the same thread
+        bool update(const OpenNIUtil::CameraInformations& camInfo);
+
+    private:
+        std::atomic<int> _angle{0};
+
+        bool _correcting = false;
+        // Sensor time of the last command (in µs)
+        int64_t _lastCommandTime = -1;
+};
+
+#endif // AUTOTILTCONTROLLER_H
@@ -0,0 +1,225 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "depthframepool.h"
+
+#include <cstring>
+
+//
+// DepthFrame
+//
+
+DepthFrame::DepthFrame(DepthFramePool *pool, int slot): _pool(pool), _slot(slot)
+{
+}
+
+DepthFrame::DepthFrame(const DepthFrame& other): _pool(other._pool), _slot(other._slot)
+{
+    if(_pool != nullptr)
+        _pool->reference(_slot);
+}
+
+DepthFrame::DepthFrame(DepthFrame&& other): _pool(other._pool), _slot(other._slot)
+{
+    other._pool = nullptr;
+    other._slot = -1;
+}
+
+DepthFrame::~DepthFrame()
+{
+    reset();
+}
+
+DepthFrame& DepthFrame::operator=(const DepthFrame& other)
+{
+    if(this != &other)
+    {
+        if(other._pool != nullptr)
+            other._pool->reference(other._slot);
+        reset();
+        _pool = other._pool;
+        _slot = other._slot;
+    }
+    return *this;
+}
+
+DepthFrame& DepthFrame::operator=(DepthFrame&& other)
+{
+    if(this != &other)
+    {
+        reset();
+        _pool = other._pool;
+        _slot = other._slot;
+        other._pool = nullptr;
+        other._slot = -1;
+    }
+    return *this;
+}
+
+void DepthFrame::reset()
+{
+    if(_pool != nullptr)
+        _pool->release(_slot);
+    _pool = nullptr;
+    _slot = -1;
+}
+
+bool DepthFrame::isNull() const
+{
+    return _pool == nullptr;
+}
+
+const XnDepthPixel *DepthFrame::data() const
+{
+    return _pool != nullptr ? _pool->_slots[_slot].data.get() : nullptr;
+}
+
+int DepthFrame::width() const
+{
+    return _pool != nullptr ? _pool->_slots[_slot].width.load(std::memory_order_relaxed) : 0;
+}
+
+int DepthFrame::height() const
+{
+    return _pool != nullptr ? _pool->_slots[_slot].height.load(std::memory_order_relaxed) : 0;
+}
+
+uint32_t DepthFrame::frameNumber() const
+{
+    return _pool != nullptr ? _pool->_slots[_slot].frameNumber.load(std::memory_order_relaxed) : 0;
+}
+
+//
+// DepthFramePool
+//
+
+DepthFramePool::DepthFramePool(const int size, const int maxLength): _size(size), _maxLength(maxLength), _slots(new Slot[size])
+{
+    for(int i=0; i < _size; ++i)
+        _slots[i].data.reset(new XnDepthPixel[_maxLength]());
+}
+
+DepthFramePool::~DepthFramePool()
+{
+}
+
+DepthFrame DepthFramePool::copy(const XnDepthPixel *depthMap, const int width, const int height, const uint32_t frameNumber)
+{
+    if(width * height > _maxLength)
+    {
+        _droppedFrames.fetch_add(1, std::memory_order_relaxed);
+        return DepthFrame();
+    }
+
+    // Find a free slot and take it (the reference is then owned by the returned handle)
+    // Slots held by a handle or by the pool are never free
+    int slot = -1;
+    for(int i=0; i < _size && slot == -1; ++i)
+    {
+        int expected = 0;
+        if(_slots[i].references.compare_exchange_strong(expected, 1, std::memory_order_acquire))
+            slot = i;
+    }
+
+    if(slot == -1)
+    {
+        _droppedFrames.fetch_add(1, std::memory_order_relaxed);
+        return DepthFrame();
+    }
+
+    const int used = _usedSlots.fetch_add(1, std::memory_order_relaxed) + 1;
+    if(used > _highWaterMark.load(std::memory_order_relaxed))
+        _highWaterMark.store(used, std::memory_order_relaxed);
+
+    std::memcpy(_slots[slot].data.get(), depthMap, width * height * sizeof(XnDepthPixel));
+    _slots[slot].frameNumber.store(frameNumber, std::memory_order_relaxed);
+    _slots[slot].width.store(width, std::memory_order_relaxed);
+    _slots[slot].height.store(height, std::memory_order_relaxed);
+
+    return DepthFrame(this, slot);
+}
+
+void DepthFramePool::publish(const DepthFrame& frame)
+{
+    if(frame._pool != this)
+        return;
+
+    // Reference owned by the pool while the frame is the latest one
+    reference(frame._slot);
+    const int previous = _latest.exchange(frame._slot, std::memory_order_acq_rel);
+
+    // The previous frame is not the latest anymore, drop the pool reference
+    if(previous != -1)
+        release(previous);
+}
+
+DepthFrame DepthFramePool::latest()
+{
+    while(true)
+    {
+        const int slot = _latest.load(std::memory_order_acquire);
+        if(slot == -1)
+            return DepthFrame();
+
+        if(tryReference(slot))
+        {
+            // If the slot is still the latest one, it was fully written before being published
+            if(_latest.load(std::memory_order_acquire) == slot)
+                return DepthFrame(this, slot);
+            release(slot);
+        }
+    }
+}
+
+int DepthFramePool::size() const
+{
+    return _size;
+}
+
+int DepthFramePool::highWaterMark() const
+{
+    return _highWaterMark.load(std::memory_order_relaxed);
+}
+
+uint64_t DepthFramePool::droppedFrames() const
+{
+    return _droppedFrames.load(std::memory_order_relaxed);
+}
+
+// Private
+bool DepthFramePool::tryReference(const int slot)
+{
+    int references = _slots[slot].references.load(std::memory_order_relaxed);
+    while(references > 0)
+    {
+        if(_slots[slot].references.compare_exchange_weak(references, references + 1, std::memory_order_acquire))
+            return true;
+    }
+    return false;
+}
+
+void DepthFramePool::reference(const int slot)
+{
+    _slots[slot].references.fetch_add(1, std::memory_order_relaxed);
+}
+
+void DepthFramePool::release(const int slot)
+{
+    if(_slots[slot].references.fetch_sub(1, std::memory_order_release) == 1)
+        _usedSlots.fetch_sub(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,126 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DEPTHFRAMEPOOL_H
+#define DEPTHFRAMEPOOL_H
+
+#include <ni/XnTypes.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "openniutil.h"
+
+#define DEFAULT_DEPTH_FRAME_POOL_SIZE 4
+
+class DepthFramePool;
+
+// Shared ownership handle on a frame of a DepthFramePool.
+// The frame stays untouched by the sensor thread as long as a handle exists.
+class DepthFrame
+{
+    public:
+        DepthFrame() {}
+        DepthFrame(const DepthFrame& other);
+        DepthFrame(DepthFrame&& other);
+        ~DepthFrame();
+
+        DepthFrame& operator=(const DepthFrame& other);
+        DepthFrame& operator=(DepthFrame&& other);
+
+        bool isNull() const;
+
+        // The depth map (values are in mm)
+        const XnDepthPixel *data() const;
+        int width() const;
+        int height() const;
+        // The number given when the frame was published
+        uint32_t frameNumber() const;
+
+    private:
+        friend class DepthFramePool;
+        DepthFrame(DepthFramePool *pool, int slot);
+
+        void reset();
+
+        DepthFramePool *_pool = nullptr;
+        int _slot = -1;
+};
+
+// Fixed-size pool of preallocated depth maps.
+// One thread (the sensor thread) copies the frames, one thread publishes them (it can be the same),
+// and any thread can get a handle on the latest one.
+// Nothing is allocated after the construction: each slot can hold maxLength pixels,
+// so the resolution of the frames can change without reallocation.
+class DepthFramePool
+{
+    public:
+        explicit DepthFramePool(const int size = DEFAULT_DEPTH_FRAME_POOL_SIZE, const int maxLength = MAX_DEPTH_MAP_LENGTH);
+        ~DepthFramePool();
+
+        DepthFramePool(const DepthFramePool&) = delete;
+        DepthFramePool& operator=(const DepthFramePool&) = delete;
+
+        // Copy the depth map in a free slot, without publishing it.
+        // If all slots are held (or if the map is too large), the frame is dropped and a null frame is returned.
+        // Must only be called from one thread.
+        DepthFrame copy(const XnDepthPixel *depthMap, const int width, const int height, const uint32_t frameNumber);
+        // Make a copied frame the latest one
+        // Must only be called from one thread.
+        void publish(const DepthFrame& frame);
+
+        // Return the latest published frame (null if nothing was published)
+        DepthFrame latest();
+
+        int size() const;
+        // Maximum number of slots used at the same time
+        int highWaterMark() const;
+        // Number of frames not published because the pool was full
+        uint64_t droppedFrames() const;
+
+    private:
+        friend class DepthFrame;
+
+        struct Slot
+        {
+            // 0 means the slot is free.
+            // The latest frame holds one reference for the pool itself
+            std::atomic<int> references{0};
+            std::atomic<uint32_t> frameNumber{0};
+            std::atomic<int> width{0};
+            std::atomic<int> height{0};
+            std::unique_ptr<XnDepthPixel[]> data;
+        };
+
+        // Only succeed if the slot is not free
+        bool tryReference(const int slot);
+        void reference(const int slot);
+        void release(const int slot);
+
+        const int _size;
+        const int _maxLength;
+        std::unique_ptr<Slot[]> _slots;
+
+        std::atomic<int> _latest{-1};
+
+        std::atomic<int> _usedSlots{0};
+        std::atomic<int> _highWaterMark{0};
+        std::atomic<uint64_t> _droppedFrames{0};
+};
+
+#endif // DEPTHFRAMEPOOL_H
@@ -0,0 +1,302 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "depthimage.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DEPTH_IMAGE_X86
+#include <immintrin.h>
+#endif
+
+// Number of depth pixels converted at once by drawDepthMap()
+#define COLOR_CHUNK_SIZE 640
+
+static uint32_t packColor(const float r, const float g, const float b)
+{
+    const auto channel = [](const float value) {
+        return static_cast<uint32_t>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+    };
+    return (channel(r) << 16) | (channel(g) << 8) | channel(b);
+}
+
+// Polynomial approximation of the Turbo colormap, t in [0;1]
+static uint32_t turboColor(const float t)
+{
+    const float r = 0.13572138f + t*(4.61539260f + t*(-42.66032258f + t*(132.13108234f + t*(-152.94239396f + t*59.28637943f))));
+    const float g = 0.09140261f + t*(2.19418839f + t*(4.84296658f + t*(-14.18503333f + t*(4.27729857f + t*2.82956604f))));
+    const float b = 0.10667330f + t*(12.64194608f + t*(-60.58204836f + t*(110.36276771f + t*(-89.90310912f + t*27.34824973f))));
+    return packColor(r, g, b);
+}
+
+//
+// DepthColorTable
+//
+
+DepthColorTable::DepthColorTable()
+{
+    defaultRange(_palette, &_nearDepth, &_farDepth);
+    build();
+}
+
+void DepthColorTable::setPalette(const DepthPalette palette, const int nearDepth, const int farDepth)
+{
+    if(palette == _palette && nearDepth == _nearDepth && farDepth == _farDepth)
+        return;
+
+    _palette = palette;
+    _nearDepth = nearDepth;
+    // Avoid a null range
+    _farDepth = std::max(farDepth, nearDepth + 1);
+    build();
+}
+
+DepthPalette DepthColorTable::palette() const
+{
+    return _palette;
+}
+
+int DepthColorTable::nearDepth() const
+{
+    return _nearDepth;
+}
+
+int DepthColorTable::farDepth() const
+{
+    return _farDepth;
+}
+
+const uint32_t* DepthColorTable::colors() const
+{
+    return _colors;
+}
+
+void DepthColorTable::defaultRange(const DepthPalette palette, int *nearDepth, int *farDepth)
+{
+    switch(palette)
+    {
+        case DepthPalette::Turbo:
+            // Range of the skeleton tracking
+            *nearDepth = 500;
+            *farDepth = 4500;
+            break;
+        case DepthPalette::NearRange:
+            // Where the player usually stands
+            *nearDepth = 800;
+            *farDepth = 2500;
+            break;
+        default:
+            // We don't want to see after 10 meters
+            *nearDepth = 0;
+            *farDepth = 10000;
+            break;
+    }
+}
+
+// Private
+void DepthColorTable::build()
+{
+    const float range = static_cast<float>(_farDepth - _nearDepth);
+
+    // No depth
+    _colors[0] = 0;
+    for(int i=1; i < DEPTH_COLOR_TABLE_SIZE; ++i)
+    {
+        const int depth = i << DEPTH_COLOR_SHIFT;
+        const bool inRange = depth >= _nearDepth && depth <= _farDepth;
+        const float t = std::min(std::max((depth - _nearDepth) / range, 0.0f), 1.0f);
+
+        switch(_palette)
+        {
+            case DepthPalette::Turbo:
+                // Near is red
+                _colors[i] = turboColor(1.0f - t);
+                break;
+            case DepthPalette::NearRange:
+                if(inRange)
+                    _colors[i] = packColor(1.0f, 1.0f - 0.75f * t, 0.0f);
+                else
+                {
+                    const float level = std::min(depth / 10000.0f, 1.0f) / 3.0f;
+                    _colors[i] = packColor(level, level, level);
+                }
+                break;
+            default:
+            {
+                const uint32_t level = std::min<uint32_t>(static_cast<uint32_t>(t * 256.0f), UINT8_MAX);
+                _colors[i] = level * 0x00010101u;
+                break;
+            }
+        }
+    }
+}
+
+//
+// Kernels
+//
+
+static void depthToColorsScalar(const XnDepthPixel *depth, uint32_t *colors, const int count, const uint32_t *table)
+{
+    for(int i=0; i < count; ++i)
+        colors[i] = table[std::min(depth[i] >> DEPTH_COLOR_SHIFT, DEPTH_COLOR_TABLE_SIZE - 1)];
+}
+
+// Each color is written res times
+static void expandColorsScalar(const uint32_t *colors, uint32_t *pixels, const int count, const int res)
+{
+    for(int i=0; i < count; ++i)
+    {
+        for(int j=0; j < res; ++j)
+            *pixels++ = colors[i];
+    }
+}
+
+#ifdef DEPTH_IMAGE_X86
+
+__attribute__((target("avx2")))
+static void depthToColorsAVX2(const XnDepthPixel *depth, uint32_t *colors, const int count, const uint32_t *table)
+{
+    const __m256i maxIndex = _mm256_set1_epi32(DEPTH_COLOR_TABLE_SIZE - 1);
+    const int *base = reinterpret_cast<const int*>(table);
+
+    int i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        const __m256i depths = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(depth + i)));
+        const __m256i indexes = _mm256_min_epu32(_mm256_srli_epi32(depths, DEPTH_COLOR_SHIFT), maxIndex);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(colors + i), _mm256_i32gather_epi32(base, indexes, 4));
+    }
+
+    depthToColorsScalar(depth + i, colors + i, count - i, table);
+}
+
+#ifdef __SSE2__
+// Only res 2 is vectorized (the size used by the GUI)
+static void expandColorsSSE2(const uint32_t *colors, uint32_t *pixels, const int count, const int res)
+{
+    if(res != 2)
+    {
+        expandColorsScalar(colors, pixels, count, res);
+        return;
+    }
+
+    int i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(colors + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels), _mm_unpacklo_epi32(values, values));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + 4), _mm_unpackhi_epi32(values, values));
+        pixels += 8;
+    }
+
+    expandColorsScalar(colors + i, pixels, count - i, res);
+}
+#endif
+
+#endif // DEPTH_IMAGE_X86
+
+typedef void (*DepthToColorsKernel)(const XnDepthPixel*, uint32_t*, const int, const uint32_t*);
+typedef void (*ExpandColorsKernel)(const uint32_t*, uint32_t*, const int, const int);
+
+static DepthToColorsKernel selectDepthToColors(const char **name)
+{
+#ifdef DEPTH_IMAGE_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+    {
+        *name = "AVX2";
+        return &depthToColorsAVX2;
+    }
+#endif
+    *name = "scalar";
+    return &depthToColorsScalar;
+}
+
+// Selected once, before main()
+static const char *kernel = nullptr;
+static const DepthToColorsKernel depthToColorsKernel = selectDepthToColors(&kernel);
+#if defined(DEPTH_IMAGE_X86) && defined(__SSE2__)
+static const ExpandColorsKernel expandColorsKernel = &expandColorsSSE2;
+#else
+static const ExpandColorsKernel expandColorsKernel = &expandColorsScalar;
+#endif
+
+void DepthImage::depthToColors(const XnDepthPixel *depth, uint32_t *colors, const int count, const DepthColorTable& table)
+{
+    depthToColorsKernel(depth, colors, count, table.colors());
+}
+
+void DepthImage::drawDepthMap(uint8_t *image, const size_t step, const XnDepthPixel *depthMap,
+                              const int width, const int height, const int res, const DepthColorTable& table)
+{
+    const size_t rowBytes = static_cast<size_t>(width) * res * sizeof(uint32_t);
+    uint32_t colors[COLOR_CHUNK_SIZE];
+
+    for(int y=0; y < height; ++y)
+    {
+        uint8_t *row = image + static_cast<size_t>(y) * res * step;
+        uint32_t *pixels = reinterpret_cast<uint32_t*>(row);
+        const XnDepthPixel *depth = depthMap + static_cast<size_t>(y) * width;
+
+        // The colors are the pixels
+        if(res == 1)
+        {
+            depthToColors(depth, pixels, width, table);
+            continue;
+        }
+
+        for(int x=0; x < width; x += COLOR_CHUNK_SIZE)
+        {
+            const int count = width - x < COLOR_CHUNK_SIZE ? width - x : COLOR_CHUNK_SIZE;
+            depthToColors(depth + x, colors, count, table);
+            expandColorsKernel(colors, pixels + static_cast<size_t>(x) * res, count, res);
+        }
+
+        // The other rows of the squares are copies of the first one
+        for(int i=1; i < res; ++i)
+            std::memcpy(row + i * step, row, rowBytes);
+    }
+}
+
+const char* DepthImage::kernelName()
+{
+    return kernel;
+}
+
+bool DepthImage::depthToColorsWith(const Kernel kernel, const XnDepthPixel *depth, uint32_t *colors, const int count,
+                                   const DepthColorTable& table)
+{
+    switch(kernel)
+    {
+        case Kernel::Scalar:
+            depthToColorsScalar(depth, colors, count, table.colors());
+            return true;
+        case Kernel::AVX2:
+#ifdef DEPTH_IMAGE_X86
+            if(__builtin_cpu_supports("avx2"))
+            {
+                depthToColorsAVX2(depth, colors, count, table.colors());
+                return true;
+            }
+#endif
+            return false;
+    }
+    return false;
+}
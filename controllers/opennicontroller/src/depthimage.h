@@ -0,0 +1,99 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DEPTHIMAGE_H
+#define DEPTHIMAGE_H
+
+#include <ni/XnTypes.h>
+#include <cstddef>
+#include <cstdint>
+
+// Number of entries of a color table
+// A depth (in mm) is looked up with depth >> DEPTH_COLOR_SHIFT, so 8192 entries of 2 mm cover 16 m
+#define DEPTH_COLOR_TABLE_SIZE 8192
+#define DEPTH_COLOR_SHIFT 1
+
+enum class DepthPalette
+{
+    // Black to white with the distance (default)
+    Gray,
+    // Red to blue with the distance, see <https://ai.googleblog.com/2019/08/turbo-improved-rainbow-colormap-for.html>
+    Turbo,
+    // Yellow to orange in the range, dim gray outside (to find the user quickly)
+    NearRange
+};
+
+// Colors of the depths for a palette, packed as 0x00RRGGBB (so B, G, R, A in memory)
+// The pixels without depth are black
+class DepthColorTable
+{
+    public:
+        // Gray palette with its default range
+        DepthColorTable();
+
+        // Rebuild the table if the palette or the range (in mm) changed
+        void setPalette(const DepthPalette palette, const int nearDepth, const int farDepth);
+
+        DepthPalette palette() const;
+        int nearDepth() const;
+        int farDepth() const;
+
+        const uint32_t* colors() const;
+
+        // Range used if none is given
+        static void defaultRange(const DepthPalette palette, int *nearDepth, int *farDepth);
+
+    private:
+        void build();
+
+        DepthPalette _palette = DepthPalette::Gray;
+        int _nearDepth = 0;
+        int _farDepth = 0;
+
+        uint32_t _colors[DEPTH_COLOR_TABLE_SIZE];
+};
+
+// Conversion of the depth maps to BGRA images, without OpenCV.
+// The kernels use AVX2 or SSE2 when the CPU supports them, and plain C++ otherwise.
+namespace DepthImage
+{
+    // One table lookup per depth
+    void depthToColors(const XnDepthPixel *depth, uint32_t *colors, const int count, const DepthColorTable& table);
+
+    // Draw the depth map in a BGRA image (4 bytes per pixel, aligned) starting at the pointer,
+    // each depth pixel is drawn as a square of res x res pixels
+    // The step is the size of an image row in bytes
+    void drawDepthMap(uint8_t *image, const size_t step, const XnDepthPixel *depthMap,
+                      const int width, const int height, const int res, const DepthColorTable& table);
+
+    // Name of the kernel used by depthToColors() ("AVX2" or "scalar")
+    const char* kernelName();
+
+    enum class Kernel
+    {
+        Scalar,
+        AVX2
+    };
+
+    // Same as depthToColors() with the given kernel, used to compare them
+    // Return false (and convert nothing) if the CPU doesn't support the kernel
+    bool depthToColorsWith(const Kernel kernel, const XnDepthPixel *depth, uint32_t *colors, const int count,
+                           const DepthColorTable& table);
+}
+
+#endif // DEPTHIMAGE_H
@@ -0,0 +1,242 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "hudrenderer.h"
+#include "opencvutil.h"
+#include "controllercommon.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
+#include <string>
+
+#define IMG_RES 2
+#define LEFT_PART_WIDTH (DEFAULT_DEPTH_MAP_WIDTH*IMG_RES)
+#define RIGHT_PART_WIDTH (400*IMG_RES)
+#define IMG_WIDTH (LEFT_PART_WIDTH + RIGHT_PART_WIDTH)
+#define IMG_HEIGHT (DEFAULT_DEPTH_MAP_HEIGHT*IMG_RES)
+
+#define FONT_FACE cv::FONT_HERSHEY_DUPLEX
+
+#define WALK_LINE_START (LEFT_PART_WIDTH + 100)
+#define WALK_LINE_END (IMG_WIDTH - 100)
+#define WALK_LINE_WIDTH (WALK_LINE_END - WALK_LINE_START)
+#define WALK_LINE_HEIGHT (IMG_HEIGHT - 80)
+#define WALK_LINE_THICKNESS 20
+#define WALK_LINE_RATIO (WALK_LINE_WIDTH / WALK_SPEED_POSSIBILITIES)
+
+// Outer radius of the moving part of the dial
+#define DIAL_RADIUS (94*IMG_RES)
+
+#define COLOR_1 CV_RGB(0, 255, 255)
+#define COLOR_2 CV_RGB(72, 209, 204)
+#define COLOR_3 CV_RGB(0, 128, 128)
+#define BACK_COLOR CV_RGB(10, 10, 10)
+// The alpha channel is ignored by the viewer
+
+// Scale used to fill the left part with a depth map of the given size
+static int depthMapRes(const int width, const int height)
+{
+    if(width <= 0 || height <= 0)
+        return IMG_RES;
+    return std::max(1, std::min(LEFT_PART_WIDTH / width, IMG_HEIGHT / height));
+}
+
+static cv::Point dialCenter()
+{
+    return cv::Point((RIGHT_PART_WIDTH/IMG_RES) + LEFT_PART_WIDTH, 280);
+}
+
+// The GUI of the right part is inspired by this picture :
+// <http://i.ytimg.com/vi/YAXsZphpiu8/maxresdefault.jpg>
+std::shared_ptr<const cv::Mat> HudRenderer::render(const OpenNIUtil::CameraInformations& camInfo,
+                                                   const DepthFrame& depthFrame, const DepthColorTable& depthColors)
+{
+    const cv::Size size(IMG_WIDTH, IMG_HEIGHT);
+    if(_staticLayer.size() != size)
+        drawStaticLayer(size);
+
+    // Area covered by the depth map, it doesn't need to be restored
+    cv::Rect depthRect;
+    const int depthRes = depthMapRes(depthFrame.width(), depthFrame.height());
+    if(!depthFrame.isNull())
+        depthRect = cv::Rect(0, 0, depthFrame.width() * depthRes, depthFrame.height() * depthRes);
+
+    Buffer* bufferPtr = nextBuffer(depthRect);
+    // Both images are still held, the frame is dropped
+    if(bufferPtr == nullptr)
+        return nullptr;
+    Buffer& buffer = *bufferPtr;
+    cv::Mat& output = *buffer.image;
+
+    //
+    // Left part
+    //
+
+    const cv::Rect leftPart(0, 0, LEFT_PART_WIDTH, IMG_HEIGHT);
+    // The skeleton can't go over the right part
+    cv::Mat left = output(leftPart);
+    addDirtyRect(buffer, leftPart);
+
+    if(!depthFrame.isNull())
+        OpenCVUtil::drawDepthMap(left, depthFrame.data(), depthFrame.width(), depthFrame.height(), depthColors,
+                                 0, 0, depthRes);
+
+    // The projective positions are relative to the depth map
+    const int userRes = depthMapRes(camInfo.depthWidth, camInfo.depthHeight);
+    OpenCVUtil::drawLimbsOfUser(left, camInfo.user, CV_RGB(0, 180, 0), 0, 0, userRes);
+    OpenCVUtil::drawJointsOfUser(left, camInfo.user, CV_RGB(255, 0, 0), CV_RGB(0, 0, 255), CV_RGB(120, 0, 0), 0, 0, userRes);
+
+    //
+    // Moving part of the dial
+
+    std::string textRotation = "???";
+
+    // Check if we have the rotation
+    if(camInfo.user.rotation != -1)
+    {
+        _dialOrientation = camInfo.user.rotation;
+        textRotation = std::to_string(camInfo.user.rotation);
+    }
+    else
+    {
+        _dialOrientation += 5;
+        if(_dialOrientation >= 360)
+            _dialOrientation = 360 - _dialOrientation;
+    }
+
+    // Set the dial start and dial end
+    const int dialStart = _dialOrientation - 25;
+    const int dialEnd = _dialOrientation + 25;
+
+    const cv::Point circleCenter = dialCenter();
+    cv::ellipse(output, circleCenter, cv::Size(DIAL_RADIUS, DIAL_RADIUS), 0, dialStart, dialEnd, COLOR_2, -1);
+    cv::ellipse(output, circleCenter, cv::Size(91*IMG_RES, 91*IMG_RES), 0, dialStart - 3, dialEnd + 3, BACK_COLOR, -1);
+    cv::ellipse(output, circleCenter, cv::Size(89*IMG_RES, 89*IMG_RES), 0, dialStart, dialEnd, COLOR_2, -1);
+    cv::ellipse(output, circleCenter, cv::Size(65*IMG_RES, 65*IMG_RES), 0, dialStart - 3, dialEnd + 3, BACK_COLOR, -1);
+    addDirtyRect(buffer, cv::Rect(circleCenter.x - DIAL_RADIUS - 1, circleCenter.y - DIAL_RADIUS - 1,
+                                  2*DIAL_RADIUS + 3, 2*DIAL_RADIUS + 3));
+
+    // Print rotation in the center of the circle
+    addDirtyRect(buffer, OpenCVUtil::drawTextCentered(output, textRotation, circleCenter, FONT_FACE, 4, COLOR_1, 4));
+
+    //
+    // Walk speed marker
+
+    std::string textWalkSpeed = "??";
+
+    // Draw vertical line and walk speed value
+    if(camInfo.user.walkSpeed != -1)
+    {
+        _walkSpeed = camInfo.user.walkSpeed;
+        textWalkSpeed = std::to_string(camInfo.user.walkSpeed);
+    }
+    else
+    {
+        _walkSpeed += _walkSpeedIncrease;
+        if(_walkSpeed > MAX_WALK_SPEED || _walkSpeed < MIN_WALK_SPEED)
+        {
+            _walkSpeedIncrease *= -1;
+            _walkSpeed += _walkSpeedIncrease;
+        }
+    }
+
+    const int currentWalkSpeedX = WALK_LINE_START + (_walkSpeed * WALK_LINE_RATIO);
+    cv::line(output, cv::Point(currentWalkSpeedX, WALK_LINE_HEIGHT - 30), cv::Point(currentWalkSpeedX, WALK_LINE_HEIGHT - 60), COLOR_2, 10);
+    addDirtyRect(buffer, cv::Rect(currentWalkSpeedX - 6, WALK_LINE_HEIGHT - 66, 13, 43));
+
+    addDirtyRect(buffer, OpenCVUtil::drawTextCentered(output, textWalkSpeed, cv::Point(currentWalkSpeedX, WALK_LINE_HEIGHT - 100),
+                                                      FONT_FACE, 2, COLOR_2, 2));
+
+    // The buffer is handed back when the last holder drops the image (usually the viewer,
+    // after the upload), the release pairs with the acquire in nextBuffer()
+    buffer.inUse->store(true, std::memory_order_relaxed);
+    const std::shared_ptr<cv::Mat> image = buffer.image;
+    const std::shared_ptr<std::atomic<bool>> inUse = buffer.inUse;
+    return std::shared_ptr<const cv::Mat>(image.get(), [image, inUse](const cv::Mat*) {
+        inUse->store(false, std::memory_order_release);
+    });
+}
+
+// Private
+void HudRenderer::drawStaticLayer(const cv::Size& size)
+{
+    _staticLayer.create(size, CV_8UC4);
+    _staticLayer.setTo(BACK_COLOR);
+
+    // Rings of the dial
+    const cv::Point circleCenter = dialCenter();
+    cv::circle(_staticLayer, circleCenter, 100*IMG_RES, COLOR_1, 5*IMG_RES);
+    cv::circle(_staticLayer, circleCenter, 80*IMG_RES, COLOR_3, 15*IMG_RES);
+
+    // Rail and end caps of the walk speed
+    cv::line(_staticLayer, cv::Point(WALK_LINE_START, WALK_LINE_HEIGHT), cv::Point(WALK_LINE_END, WALK_LINE_HEIGHT), COLOR_1, WALK_LINE_THICKNESS);
+    cv::line(_staticLayer, cv::Point(LEFT_PART_WIDTH + 30, WALK_LINE_HEIGHT), cv::Point(LEFT_PART_WIDTH + 70, WALK_LINE_HEIGHT), COLOR_3, WALK_LINE_THICKNESS);
+    cv::line(_staticLayer, cv::Point(IMG_WIDTH - 30, WALK_LINE_HEIGHT), cv::Point(IMG_WIDTH - 70, WALK_LINE_HEIGHT), COLOR_3, WALK_LINE_THICKNESS);
+}
+
+HudRenderer::Buffer* HudRenderer::nextBuffer(const cv::Rect& redrawn)
+{
+    // An image can be held by the viewer and another one be on its way to it
+    Buffer* bufferPtr = nullptr;
+    for(Buffer& candidate : _buffers)
+    {
+        if(!candidate.image || !candidate.inUse->load(std::memory_order_acquire))
+        {
+            bufferPtr = &candidate;
+            break;
+        }
+    }
+    if(bufferPtr == nullptr)
+        return nullptr;
+    Buffer& buffer = *bufferPtr;
+
+    // Allocated again if the size changed
+    if(!buffer.image || buffer.image->size() != _staticLayer.size())
+    {
+        buffer.image = std::make_shared<cv::Mat>();
+        _staticLayer.copyTo(*buffer.image);
+        buffer.dirtyRectsCount = 0;
+        return bufferPtr;
+    }
+
+    for(int i=0; i < buffer.dirtyRectsCount; ++i)
+    {
+        const cv::Rect& rect = buffer.dirtyRects[i];
+        if((rect & redrawn) != rect)
+            _staticLayer(rect).copyTo((*buffer.image)(rect));
+    }
+    buffer.dirtyRectsCount = 0;
+    return bufferPtr;
+}
+
+void HudRenderer::addDirtyRect(Buffer& buffer, const cv::Rect& rect)
+{
+    const cv::Rect clipped = rect & cv::Rect(0, 0, buffer.image->cols, buffer.image->rows);
+    if(clipped.area() == 0)
+        return;
+
+    // Should not happen, restore everything
+    if(buffer.dirtyRectsCount == HUD_MAX_DIRTY_RECTS)
+    {
+        buffer.dirtyRects[0] = cv::Rect(0, 0, buffer.image->cols, buffer.image->rows);
+        buffer.dirtyRectsCount = 1;
+        return;
+    }
+
+    buffer.dirtyRects[buffer.dirtyRectsCount++] = clipped;
+}
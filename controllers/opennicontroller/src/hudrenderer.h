@@ -0,0 +1,83 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HUDRENDERER_H
+#define HUDRENDERER_H
+
+#include <opencv2/core/core.hpp>
+#include <atomic>
+#include <memory>
+
+#include "openniutil.h"
+#include "depthframepool.h"
+#include "depthimage.h"
+
+// Maximum number of areas drawn by the dynamic elements of a frame
+#define HUD_MAX_DIRTY_RECTS 8
+
+// Draw the OpenNI data in an image with two parts:
+// - left part with the depth data and skeleton
+// - right part with some informations
+//
+// The images are BGRA (CV_8UC4), the layout uploaded as is in an OpenGL texture.
+//
+// The background and the static elements of the right part are drawn once
+// in a cached layer, drawn again only if the size of the image changes.
+// Two output images are used in turn: the viewer keeps the last one until it's uploaded,
+// the next frame is drawn in the other one. An image is handed back to the renderer
+// when the last copy of the returned pointer is dropped. Before drawing a frame in an image,
+// the areas drawn the last time in this image are restored from the cached layer.
+//
+// The renderer isn't thread-safe, it's used by a single thread (see RenderWorker).
+class HudRenderer
+{
+    public:
+        // Draw all informations and return the image
+        // The image is not modified as long as the caller holds it,
+        // nullptr is returned if both images are still held
+        std::shared_ptr<const cv::Mat> render(const OpenNIUtil::CameraInformations& camInfo,
+                                              const DepthFrame& depthFrame, const DepthColorTable& depthColors);
+
+    private:
+        struct Buffer
+        {
+            std::shared_ptr<cv::Mat> image;
+            // Set while the image is held outside of the renderer
+            // Shared with the returned image, which may outlive the renderer
+            std::shared_ptr<std::atomic<bool>> inUse = std::make_shared<std::atomic<bool>>(false);
+            // Areas drawn the last time in the image
+            cv::Rect dirtyRects[HUD_MAX_DIRTY_RECTS];
+            int dirtyRectsCount = 0;
+        };
+
+        void drawStaticLayer(const cv::Size& size);
+        // Return a buffer not held by the viewer, ready to draw (nullptr if there is none)
+        // The areas not drawn again (outside the redrawn one) are restored from the static layer
+        Buffer* nextBuffer(const cv::Rect& redrawn);
+        void addDirtyRect(Buffer& buffer, const cv::Rect& rect);
+
+        cv::Mat _staticLayer;
+        Buffer _buffers[2];
+
+        // Animated when the values are unknown
+        int _dialOrientation = 0;
+        int _walkSpeed = 0;
+        int _walkSpeedIncrease = 5;
+};
+
+#endif // HUDRENDERER_H
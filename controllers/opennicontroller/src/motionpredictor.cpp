@@ -0,0 +1,154 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "motionpredictor.h"
+#include "openniutil.h"
+
+#include <algorithm>
+#include <cmath>
+
+//
+// MotionHistory
+//
+
+void MotionHistory::reset()
+{
+    _count = 0;
+    _last = -1;
+}
+
+void MotionHistory::add(const int64_t timestamp, const float rotation, const float speed)
+{
+    MotionSample sample;
+    sample.timestamp = timestamp;
+    sample.rotation = rotation;
+    sample.speed = speed;
+    if(rotation != -1.0f)
+        sample.rotationRate = rate(timestamp, rotation, true);
+    if(speed != -1.0f)
+        sample.speedRate = rate(timestamp, speed, false);
+
+    _last = (_last + 1) % MOTION_HISTORY_SIZE;
+    _samples[_last] = sample;
+    if(_count < MOTION_HISTORY_SIZE)
+        ++_count;
+}
+
+bool MotionHistory::isEmpty() const
+{
+    return _count == 0;
+}
+
+const MotionSample& MotionHistory::last() const
+{
+    return _samples[_last];
+}
+
+const MotionSample* MotionHistory::sampleAt(const int64_t timestamp) const
+{
+    for(int i=0; i < _count; ++i)
+    {
+        const MotionSample& sample = _samples[(_last - i + MOTION_HISTORY_SIZE) % MOTION_HISTORY_SIZE];
+        if(sample.timestamp <= timestamp)
+            return &sample;
+    }
+    return nullptr;
+}
+
+// Private
+float MotionHistory::rate(const int64_t timestamp, const float value, const bool angle) const
+{
+    // Times in s relative to the new sample, the angles are unwrapped around the new value
+    float sumT = 0.0f;
+    float sumV = 0.0f;
+    float sumTT = 0.0f;
+    float sumTV = 0.0f;
+    int n = 1;
+
+    for(int i=0; i < _count; ++i)
+    {
+        const MotionSample& sample = _samples[(_last - i + MOTION_HISTORY_SIZE) % MOTION_HISTORY_SIZE];
+        if(timestamp - sample.timestamp > MOTION_RATE_WINDOW)
+            break;
+
+        const float old = angle ? sample.rotation : sample.speed;
+        if(old == -1.0f)
+            break;
+
+        const float t = (sample.timestamp - timestamp) * 0.000001f;
+        const float v = angle ? OpenNIUtil::angleDifference(old, value) : old - value;
+        sumT += t;
+        sumV += v;
+        sumTT += t * t;
+        sumTV += t * v;
+        ++n;
+    }
+
+    const float denominator = n * sumTT - sumT * sumT;
+    if(n < 2 || denominator <= 0.0f)
+        return 0.0f;
+    return (n * sumTV - sumT * sumV) / denominator;
+}
+
+//
+// Prediction
+//
+
+static float predictionTime(const int64_t time)
+{
+    return std::min<int64_t>(std::max<int64_t>(time, 0), MAX_PREDICTION_TIME) * 0.000001f;
+}
+
+float predictRotation(const float rotation, const float rate, const int64_t time)
+{
+    if(rotation == -1.0f)
+        return rotation;
+
+    const float predicted = std::fmod(rotation + rate * predictionTime(time), 360.0f);
+    return predicted < 0.0f ? predicted + 360.0f : predicted;
+}
+
+float predictSpeed(const float speed, const float rate, const int64_t time)
+{
+    if(speed == -1.0f)
+        return speed;
+
+    return std::max(speed + rate * predictionTime(time), 0.0f);
+}
+
+//
+// PredictionStats
+//
+
+void PredictionStats::add(const float error, const float errorWithoutPrediction)
+{
+    _error += error;
+    _errorWithoutPrediction += errorWithoutPrediction;
+    _maxError = std::max(_maxError, error);
+    ++_samples;
+}
+
+QString PredictionStats::report(const QString& name, const QString& unit) const
+{
+    if(_samples == 0)
+        return QStringLiteral("%1 prediction: no samples").arg(name);
+
+    return QStringLiteral("%1 prediction: mean error %2 %3 (without prediction %4 %3), max %5 %3 (%6 samples)")
+            .arg(name).arg(_error / _samples, 0, 'f', 2).arg(unit)
+            .arg(_errorWithoutPrediction / _samples, 0, 'f', 2).arg(_maxError, 0, 'f', 2).arg(_samples);
+}
@@ -0,0 +1,92 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MOTIONPREDICTOR_H
+#define MOTIONPREDICTOR_H
+
+#include <QString>
+#include <cstdint>
+
+// Number of frames kept for each user
+#define MOTION_HISTORY_SIZE 8
+// Only the samples of this period (in µs) are used to estimate the rates
+#define MOTION_RATE_WINDOW 150000
+// Maximum extrapolation (in µs), older data are not extrapolated further
+#define MAX_PREDICTION_TIME 200000
+// Time between the read of the values and their use by the headset (in ms)
+#define DEFAULT_PREDICTION_HORIZON 40
+
+// Filtered values of a frame, and their rates of change (per second)
+// The values are -1 if unknown
+struct MotionSample
+{
+    int64_t timestamp = 0;
+    float rotation = -1.0f;
+    float rotationRate = 0.0f;
+    float speed = -1.0f;
+    float speedRate = 0.0f;
+};
+
+// Short history of the motion of a user, used to extrapolate it
+// This is a plain value (no allocation), so it can be stored in tables.
+class MotionHistory
+{
+    public:
+        void reset();
+
+        // Add the values of a frame (with the sensor timestamp in µs) and compute the rates
+        void add(const int64_t timestamp, const float rotation, const float speed);
+
+        bool isEmpty() const;
+        const MotionSample& last() const;
+        // Return the newest sample taken at or before the timestamp, nullptr if there is none
+        const MotionSample* sampleAt(const int64_t timestamp) const;
+
+    private:
+        // Slope of the least squares line of the values in the rate window
+        float rate(const int64_t timestamp, const float value, const bool angle) const;
+
+        MotionSample _samples[MOTION_HISTORY_SIZE];
+        int _count = 0;
+        // Index of the newest sample
+        int _last = -1;
+};
+
+// Extrapolation of the values after a time (in µs), limited to MAX_PREDICTION_TIME
+// The unknown values (-1) are returned as is
+float predictRotation(const float rotation, const float rate, const int64_t time);
+float predictSpeed(const float speed, const float rate, const int64_t time);
+
+// Error of the predictions, compared to the values measured later
+class PredictionStats
+{
+    public:
+        // The errors are absolute differences with the measured value,
+        // the second one is the error if the old value is used without prediction
+        void add(const float error, const float errorWithoutPrediction);
+
+        QString report(const QString& name, const QString& unit) const;
+
+    private:
+        uint64_t _samples = 0;
+        double _error = 0.0;
+        double _errorWithoutPrediction = 0.0;
+        float _maxError = 0.0f;
+};
+
+#endif // MOTIONPREDICTOR_H
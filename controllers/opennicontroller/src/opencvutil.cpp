@@ -21,9 +21,7 @@
 
 #include <opencv2/imgproc/imgproc.hpp>
 #include <stdint.h>
-
-// Use 10000 in the ratio since we don't want to see after 10 meters
-#define DEPTH_IMAGE_RATIO (256.0f / 10000.0f)
+#include <algorithm>
 
 cv::Point2i OpenCVUtil::pointTo2DCV(const XnVector3D pt, const int offsetX, const int offsetY, const int res)
 {
@@ -83,156 +81,24 @@ void OpenCVUtil::drawLimbsOfUser(cv::Mat &image, const OpenNIUtil::User user, co
     drawLimb(image, user.leftPart.shoulder, user.rightPart.shoulder, color, offsetX, offsetY, res);
 }
 
-void OpenCVUtil::drawTextCentered(cv::Mat& image, const std::string& text, const cv::Point& centerPoint,
-                                  const int& fontFace, const double& fontScale, const cv::Scalar& color,
-                                  const int& thickness)
+cv::Rect OpenCVUtil::drawTextCentered(cv::Mat& image, const std::string& text, const cv::Point& centerPoint,
+                                      const int& fontFace, const double& fontScale, const cv::Scalar& color,
+                                      const int& thickness)
 {
-    const cv::Size textRect = cv::getTextSize(text, fontFace, fontScale, thickness, nullptr);
+    int baseline = 0;
+    const cv::Size textRect = cv::getTextSize(text, fontFace, fontScale, thickness, &baseline);
     // Compute the text origin (to have the text at the center)
     const cv::Point origin(centerPoint.x - (textRect.width/2), centerPoint.y + (textRect.height/2));
     cv::putText(image, text, origin, fontFace, fontScale, color, thickness);
-}
 
-// The image type must be CV_8UC3
-void OpenCVUtil::drawDepthMap(cv::Mat &image, XnDepthPixel* depthMap,
-                              const int startX, const int startY, const int res)
-{
-    const int depthMapWidth = 640 * res;
-    const int depthMapHeight = 480 * res;
-
-    XnDepthPixel* depthData = depthMap;
-
-    uint8_t* pixelPtr = (uint8_t*)image.data;
-    for(int r=startY; r < startY + depthMapHeight; r += res)
-    {
-        for(int c=startX; c < startX + depthMapWidth; c += res)
-        {
-            const uint16_t realColor = (*depthData) * DEPTH_IMAGE_RATIO;
-            const uint8_t color = realColor > UINT8_MAX ? UINT8_MAX : realColor;
-
-            for(int i=0; i < res; ++i)
-            {
-                for(int j=0; j < res; ++j)
-                {
-                    pixelPtr[(r+i)*image.cols*3 + (c+j)*3] = color;
-                    pixelPtr[(r+i)*image.cols*3 + (c+j)*3 + 1] = color;
-                    pixelPtr[(r+i)*image.cols*3 + (c+j)*3 + 2] = color;
-                }
-            }
-            depthData++;
-        }
-    }
+    // The strokes can go a bit outside of the text size
+    return cv::Rect(origin.x - thickness, origin.y - textRect.height - thickness,
+                    textRect.width + 2*thickness, textRect.height + baseline + 2*thickness);
 }
 
-#define IMG_RES 2
-#define LEFT_PART_WIDTH (640*IMG_RES)
-#define RIGHT_PART_WIDTH (400*IMG_RES)
-#define IMG_WIDTH (LEFT_PART_WIDTH + RIGHT_PART_WIDTH)
-#define IMG_HEIGHT (480*IMG_RES)
-
-#define FONT_FACE cv::FONT_HERSHEY_DUPLEX
-
-#define WALK_LINE_START (LEFT_PART_WIDTH + 100)
-#define WALK_LINE_END (IMG_WIDTH - 100)
-#define WALK_LINE_WIDTH (WALK_LINE_END - WALK_LINE_START)
-#define WALK_LINE_HEIGHT (IMG_HEIGHT - 80)
-#define WALK_LINE_THICKNESS 20
-#define WALK_LINE_RATIO (WALK_LINE_WIDTH / WALK_SPEED_POSSIBILITIES)
-
-#define COLOR_1 CV_RGB(0, 255, 255)
-#define COLOR_2 CV_RGB(72, 209, 204)
-#define COLOR_3 CV_RGB(0, 128, 128)
-
-static int guiDialOrientation = 0;
-static int guiWalkSpeed = 0;
-static int guiWalkSpeedIncrease = 5;
-
-// There is two parts in the image:
-// - left part with the depth data and skeleton
-// - right part with some informations
-cv::Mat OpenCVUtil::drawOpenNIData(OpenNIUtil::CameraInformations camInfo)
+// The image type must be CV_8UC4
+void OpenCVUtil::drawDepthMap(cv::Mat &image, const XnDepthPixel* depthMap, const int width, const int height,
+                              const DepthColorTable& colors, const int startX, const int startY, const int res)
 {
-    const cv::Scalar backColor = CV_RGB(10,10,10);
-    cv::Mat outputMat = cv::Mat(IMG_HEIGHT, IMG_WIDTH, CV_8UC3, backColor);
-
-    //
-    // Left part
-    //
-
-    drawDepthMap(outputMat, camInfo.depthData, 0, 0, IMG_RES);
-
-    drawLimbsOfUser(outputMat, camInfo.user, CV_RGB(0, 180, 0), 0, 0, IMG_RES);
-    drawJointsOfUser(outputMat, camInfo.user, CV_RGB(255, 0, 0), CV_RGB(0, 0, 255), CV_RGB(120, 0, 0), 0, 0, IMG_RES);
-
-    //
-    // Right part
-    // The GUI of this part is inspired by this picture :
-    // <http://i.ytimg.com/vi/YAXsZphpiu8/maxresdefault.jpg>
-    //
-
-    //
-    // Draw circle for the rotation
-
-    std::string textRotation = "???";
-
-    // Check if we have the rotation
-    if(camInfo.user.rotation != -1)
-    {
-        guiDialOrientation = camInfo.user.rotation;
-        textRotation = std::to_string(camInfo.user.rotation);
-    }
-    else
-    {
-        guiDialOrientation += 5;
-        if(guiDialOrientation >= 360)
-            guiDialOrientation = 360 - guiDialOrientation;
-    }
-
-    // Set the dial start and dial end
-    const int dialStart = guiDialOrientation - 25;
-    const int dialEnd = guiDialOrientation + 25;    
-
-    const cv::Point circleCenter((RIGHT_PART_WIDTH/IMG_RES) + LEFT_PART_WIDTH, 280);
-    cv::circle(outputMat, circleCenter, 100*IMG_RES, COLOR_1, 5*IMG_RES);
-    cv::circle(outputMat, circleCenter, 80*IMG_RES, COLOR_3, 15*IMG_RES);
-    cv::ellipse(outputMat, circleCenter, cv::Size(94*IMG_RES, 94*IMG_RES), 0, dialStart, dialEnd, COLOR_2, -1);
-    cv::ellipse(outputMat, circleCenter, cv::Size(91*IMG_RES, 91*IMG_RES), 0, dialStart - 3, dialEnd + 3, backColor, -1);
-    cv::ellipse(outputMat, circleCenter, cv::Size(89*IMG_RES, 89*IMG_RES), 0, dialStart, dialEnd, COLOR_2, -1);
-    cv::ellipse(outputMat, circleCenter, cv::Size(65*IMG_RES, 65*IMG_RES), 0, dialStart - 3, dialEnd + 3, backColor, -1);
-
-    // Print rotation in the center of the circle
-    drawTextCentered(outputMat, textRotation, circleCenter, FONT_FACE, 4, COLOR_1, 4);
-
-    //
-    // Draw the walk speed
-
-    cv::line(outputMat, cv::Point(WALK_LINE_START, WALK_LINE_HEIGHT), cv::Point(WALK_LINE_END, WALK_LINE_HEIGHT), COLOR_1, WALK_LINE_THICKNESS);
-    cv::line(outputMat, cv::Point(LEFT_PART_WIDTH + 30, WALK_LINE_HEIGHT), cv::Point(LEFT_PART_WIDTH + 70, WALK_LINE_HEIGHT), COLOR_3, WALK_LINE_THICKNESS);
-    cv::line(outputMat, cv::Point(IMG_WIDTH - 30, WALK_LINE_HEIGHT), cv::Point(IMG_WIDTH - 70, WALK_LINE_HEIGHT), COLOR_3, WALK_LINE_THICKNESS);
-
-    std::string textWalkSpeed = "??";
-
-    // Draw vertical line and walk speed value
-    if(camInfo.user.walkSpeed != -1)
-    {
-        guiWalkSpeed = camInfo.user.walkSpeed;
-        textWalkSpeed = std::to_string(camInfo.user.walkSpeed);
-    }
-    else
-    {
-        guiWalkSpeed += guiWalkSpeedIncrease;
-        if(guiWalkSpeed > MAX_WALK_SPEED || guiWalkSpeed < MIN_WALK_SPEED)
-        {
-            guiWalkSpeedIncrease *= -1;
-            guiWalkSpeed += guiWalkSpeedIncrease;
-        }
-    }
-
-    const int currentWalkSpeedX = WALK_LINE_START + (guiWalkSpeed * WALK_LINE_RATIO);
-    cv::line(outputMat, cv::Point(currentWalkSpeedX, WALK_LINE_HEIGHT - 30), cv::Point(currentWalkSpeedX, WALK_LINE_HEIGHT - 60), COLOR_2, 10);
-
-    drawTextCentered(outputMat, textWalkSpeed, cv::Point(currentWalkSpeedX, WALK_LINE_HEIGHT - 100), FONT_FACE, 2, COLOR_2, 2);
-
-    return outputMat;
+    DepthImage::drawDepthMap(image.ptr<uint8_t>(startY) + startX * 4, image.step, depthMap, width, height, res, colors);
 }
-
@@ -22,6 +22,8 @@
 #include <string>
 #include <opencv2/core/core.hpp>
 #include "openniutil.h"
+#include "depthframepool.h"
+#include "depthimage.h"
 
 // Drawing functions
 namespace OpenCVUtil
@@ -42,15 +44,14 @@ namespace OpenCVUtil
                          const int offsetX = 0, const int offsetY = 0, const int res = 1);
 
     // Draw a text centered relative to the specified point
-    void drawTextCentered(cv::Mat& image, const std::string& text, const cv::Point& centerPoint,
-                          const int &fontFace, const double &fontScale, const cv::Scalar& color,
-                          const int &thickness);
-
-    void drawDepthMap(cv::Mat& image, XnDepthPixel *depthMap,
-                      const int startX, const int startY, const int res = 1);
-
-    // Draw all informations and return the image
-    cv::Mat drawOpenNIData(OpenNIUtil::CameraInformations camInfo);
+    // Return the area covered by the text
+    cv::Rect drawTextCentered(cv::Mat& image, const std::string& text, const cv::Point& centerPoint,
+                              const int &fontFace, const double &fontScale, const cv::Scalar& color,
+                              const int &thickness);
+
+    // Each pixel of the depth map is drawn as a square of res x res pixels, with the colors of the table
+    void drawDepthMap(cv::Mat& image, const XnDepthPixel *depthMap, const int width, const int height,
+                      const DepthColorTable& colors, const int startX, const int startY, const int res = 1);
 }
 
 #endif // OPENCVUTIL_H
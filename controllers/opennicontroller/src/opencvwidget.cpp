@@ -18,7 +18,11 @@
 
 #include "opencvwidget.h"
 
-OpenCVWidget::OpenCVWidget(QWidget *parent): QGLWidget(parent)
+#include <QOpenGLContext>
+#include <cstring>
+
+OpenCVWidget::OpenCVWidget(QWidget *parent): QGLWidget(parent),
+    _pixelBuffer(QOpenGLBuffer::PixelUnpackBuffer)
 {
     _sceneChanged = false;
     _bgColor = QColor::fromRgb(10, 10, 10);
@@ -31,10 +35,36 @@ OpenCVWidget::OpenCVWidget(QWidget *parent): QGLWidget(parent)
     _posY = 0;
 }
 
+OpenCVWidget::~OpenCVWidget()
+{
+    makeCurrent();
+    if(_texture != 0)
+        glDeleteTextures(1, &_texture);
+    _pixelBuffer.destroy();
+}
+
 void OpenCVWidget::initializeGL()
 {
     makeCurrent();
     qglClearColor(_bgColor);
+
+    glGenTextures(1, &_texture);
+    glBindTexture(GL_TEXTURE_2D, _texture);
+    // The image is scaled by OpenGL
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Pixel buffers are core since OpenGL 2.1
+    const QOpenGLContext *context = QOpenGLContext::currentContext();
+    if(context != nullptr && (context->format().version() >= qMakePair(2, 1)
+                              || context->hasExtension(QByteArrayLiteral("GL_ARB_pixel_buffer_object"))))
+    {
+        _pixelBufferSupported = _pixelBuffer.create();
+        _pixelBuffer.setUsagePattern(QOpenGLBuffer::StreamDraw);
+    }
 }
 
 void OpenCVWidget::resizeGL(int width, int height)
@@ -81,62 +111,103 @@ void OpenCVWidget::updateScene()
 
 void OpenCVWidget::paintGL()
 {
-    if(!_sceneChanged)
-        return;
+    if(_image)
+        uploadImage();
 
+    // Always drawn, the texture is kept
     renderImage();
     _sceneChanged = false;
 }
 
+void OpenCVWidget::uploadImage()
+{
+    const cv::Mat& image = *_image;
+
+    glBindTexture(GL_TEXTURE_2D, _texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(image.step / image.elemSize()));
+
+    if(image.cols != _textureWidth || image.rows != _textureHeight)
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image.cols, image.rows, 0, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+        _textureWidth = image.cols;
+        _textureHeight = image.rows;
+    }
+
+    const int size = static_cast<int>(image.step * image.rows);
+    void *mapped = nullptr;
+    if(_pixelBufferSupported)
+    {
+        _pixelBuffer.bind();
+        // A new storage, so the driver doesn't wait for the end of the previous upload
+        _pixelBuffer.allocate(size);
+        mapped = _pixelBuffer.map(QOpenGLBuffer::WriteOnly);
+        if(mapped == nullptr)
+            _pixelBuffer.release();
+    }
+
+    if(mapped != nullptr)
+    {
+        // The transfer to the texture is done by the GPU
+        std::memcpy(mapped, image.data, size);
+        _pixelBuffer.unmap();
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.cols, image.rows, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+        _pixelBuffer.release();
+    }
+    else
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.cols, image.rows, GL_BGRA, GL_UNSIGNED_BYTE, image.data);
+
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // The producer can draw in this image again
+    _image.reset();
+}
+
 void OpenCVWidget::renderImage()
 {
     makeCurrent();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    if(!_renderQtImg.isNull())
+    if(_textureWidth != 0)
     {
         glLoadIdentity();
         glPushMatrix();
 
-        QImage image;
+        glEnable(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, _texture);
+        glColor3f(1.0f, 1.0f, 1.0f);
+
+        // Centering image in draw area, the first row of the image is at the top
+        glBegin(GL_QUADS);
+        glTexCoord2f(0.0f, 1.0f);
+        glVertex2i(_posX, _posY);
+        glTexCoord2f(1.0f, 1.0f);
+        glVertex2i(_posX + _outWidth, _posY);
+        glTexCoord2f(1.0f, 0.0f);
+        glVertex2i(_posX + _outWidth, _posY + _outHeight);
+        glTexCoord2f(0.0f, 0.0f);
+        glVertex2i(_posX, _posY + _outHeight);
+        glEnd();
+
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glDisable(GL_TEXTURE_2D);
 
-        const int imWidth = _renderQtImg.width();
-        const int imHeight = _renderQtImg.height();
-
-        // The image need to be resized to fit the widget ?
-        if(imWidth != size().width() && imHeight != size().height())
-            image = _renderQtImg.scaled(QSize(_outWidth, _outHeight), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
-        else
-            image = _renderQtImg;
-
-        // Centering image in draw area
-        glRasterPos2i(_posX, _posY);
-
-        glDrawPixels(image.width(), image.height(), GL_RGBA, GL_UNSIGNED_BYTE, image.bits());
         glPopMatrix();
         glFlush();
     }
 }
 
-bool OpenCVWidget::showImage(cv::Mat image)
+bool OpenCVWidget::showImage(std::shared_ptr<const cv::Mat> image)
 {
-    image.copyTo(_origImage);
+    if(!image || image->type() != CV_8UC4)
+        return false;
 
-    _imgRatio = (float)image.cols/(float)image.rows;
-    updateScale(width(), height());
+    _image = std::move(image);
 
-    if(_origImage.channels() == 3)
-        _renderQtImg = QImage((const unsigned char*)(_origImage.data),
-                              _origImage.cols, _origImage.rows,
-                              _origImage.step, QImage::Format_RGB888).rgbSwapped();
-    else if(_origImage.channels() == 1)
-        _renderQtImg = QImage((const unsigned char*)(_origImage.data),
-                              _origImage.cols, _origImage.rows,
-                              _origImage.step, QImage::Format_Indexed8);
-    else
-        return false;
+    _imgRatio = (float)_image->cols/(float)_image->rows;
+    updateScale(width(), height());
 
-    _renderQtImg = QGLWidget::convertToGLFormat(_renderQtImg);
     _sceneChanged = true;
     updateScene();
 
@@ -20,19 +20,25 @@
 #define OPENCVWIDGET_H
 
 #include <QGLWidget>
+#include <QOpenGLBuffer>
 #include <opencv2/core/core.hpp>
+#include <memory>
 
 // Simple viewer for OpenCV images
+// The image is uploaded in a texture (through a pixel buffer when available)
+// and scaled by OpenGL, the upload is the only copy of the image
 class OpenCVWidget: public QGLWidget
 {
         Q_OBJECT
 
     public:
         explicit OpenCVWidget(QWidget *parent = 0);
+        ~OpenCVWidget();
 
     public slots:
-        // Used to set the image to be viewed
-        bool showImage(cv::Mat image);
+        // Used to set the image to be viewed, it must be BGRA (CV_8UC4)
+        // The image is held (and must not be modified) until it's uploaded
+        bool showImage(std::shared_ptr<const cv::Mat> image);
 
     protected:
         // OpenGL initialization
@@ -43,6 +49,7 @@ class OpenCVWidget: public QGLWidget
         void resizeGL(int width, int height);
 
         void updateScene();
+        void uploadImage();
         void renderImage();
 
         void updateScale(int width, int height);
@@ -51,10 +58,16 @@ class OpenCVWidget: public QGLWidget
         // Indicates when OpenGL view is to be redrawn
         bool _sceneChanged;
 
-        // Qt image to be rendered
-        QImage _renderQtImg;
-        // Original OpenCV image to be shown
-        cv::Mat _origImage;
+        // Image to be uploaded, released once in the texture
+        std::shared_ptr<const cv::Mat> _image;
+
+        GLuint _texture = 0;
+        // Size of the image in the texture, null if none
+        int _textureWidth = 0;
+        int _textureHeight = 0;
+
+        QOpenGLBuffer _pixelBuffer;
+        bool _pixelBufferSupported = false;
 
         // Background color
         QColor _bgColor;
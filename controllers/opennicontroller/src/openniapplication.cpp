@@ -17,6 +17,7 @@
  */
 
 #include "openniapplication.h"
+#include "sessionrecorder.h"
 
 #include <QString>
 #include <QDebug>
@@ -24,99 +25,267 @@
 #include <chrono>
 #include <cmath>
 
-// These defines are used to avoid to much code repetition
-#define CHECK_ERROR(retVal, what)                                                                                                                  \
-    if(retVal != XN_STATUS_OK)                                                                                                                     \
-    {                                                                                                                                              \
-        qCritical() << qPrintable(QObject::tr("%1 failed: %2", "%1 is what failed and %2 is the error from OpenNI SDK.").arg(what).arg(xnGetStatusString(retVal)));   \
-        return retVal;                                                                                                                             \
-    }
-
-#define GET_OPENNI_APP(cookie, app)                                                    \
-    app = static_cast<OpenNIApplication*>(cookie);                                     \
-    if(app == nullptr)                                                                 \
-    {                                                                                  \
-        qCritical() << qPrintable(QObject::tr("Cannot get the OpenNI application."));  \
-        return;                                                                        \
-    }
-
-//
-// Internal callbacks, only called by OpenNI internaly
-// The OpenNIApplicationr is represented by the *cookie pointer
-//
-
-void XN_CALLBACK_TYPE newUserCallback(xn::UserGenerator& /*generator*/, XnUserID userID, void* cookie)
+OpenNIApplication::OpenNIApplication(SensorSource *source, PipelineStats *stats, QObject *parent) : QObject(parent),
+    // Some slots are kept for the frames held by the session recorder
+    _depthFramePool(DEFAULT_DEPTH_FRAME_POOL_SIZE + SESSION_MAX_DEPTH_FRAMES + PIPELINE_MAX_DEPTH_FRAMES)
 {
-    // New user found, start calibration
-    OpenNIApplication *app;
-    GET_OPENNI_APP(cookie, app);
-    qDebug() << qPrintable(QObject::tr("New user: %1").arg(userID));
-    app->startCalibration(userID);
+    _rotationFilter = defaultRotationFilter();
+    _speedFilter = defaultSpeedFilter();
+    _stats = stats;
+    _source = source;
 }
 
-void XN_CALLBACK_TYPE lostUserCallback(xn::UserGenerator& /*generator*/, XnUserID userID, void* cookie)
+OpenNIApplication::~OpenNIApplication()
 {
-    OpenNIApplication *app;
-    GET_OPENNI_APP(cookie, app);
-    qDebug() << qPrintable(QObject::tr("Lost user: %1").arg(userID));
+    cleanup();
+    delete _source;
 }
 
-void XN_CALLBACK_TYPE calibrationStartCallback(xn::SkeletonCapability& /*capability*/, XnUserID userID, void* cookie)
+// Private
+void OpenNIApplication::cleanup()
 {
-    OpenNIApplication *app;
-    GET_OPENNI_APP(cookie, app);
-    qDebug() << qPrintable(QObject::tr("Calibration started for user: %1").arg(userID));
+    std::lock_guard<std::mutex> lock(_stopMutex);
+    if(_stopped)
+        return;
+
+    _source->release();
+
+    qDebug() << qPrintable(tr("Depth frame pool: %1 slots used at most on %2, %3 frames dropped.")
+                           .arg(_depthFramePool.highWaterMark()).arg(_depthFramePool.size())
+                           .arg(_depthFramePool.droppedFrames()));
+    qDebug() << qPrintable(tr("Sensor frames missed: %1, skipped without new skeleton data: %2.")
+                           .arg(_droppedSensorFrames).arg(_skippedFrames));
+    if(_stalls > 0)
+        qDebug() << qPrintable(tr("Sensor stalls: %1.").arg(_stalls.load()));
+    // Used to compare the filter settings on the same recorded session
+    qDebug() << qPrintable(_userTable.filterReport());
+
+    _stopped = true;
+    _stopCondition.notify_all();
 }
 
-void XN_CALLBACK_TYPE calibrationEndCallback(xn::SkeletonCapability& /*capability*/, XnUserID userID, XnCalibrationStatus calibrationStatus, void* cookie)
+OpenNIApplication::WaitResult OpenNIApplication::waitForFrame()
 {
-    OpenNIApplication *app;
-    GET_OPENNI_APP(cookie, app);
-    // Check the status
-    if(calibrationStatus == XN_CALIBRATION_STATUS_OK)
+    while(!_stopRequested)
     {
-        // Calibration succeeded
-        qDebug() << qPrintable(QObject::tr("Calibration complete, start tracking user %1").arg(userID));
-        app->startTracking(userID);
+        if(_source->waitForNewFrame(FRAME_WAIT_TIMEOUT))
+        {
+            if(!_source->update())
+                return WaitResult::Stopped;
+            _lastFrameTime = LatencyTimer::now();
+            return WaitResult::Frame;
+        }
+
+        if(_stallTimeout > 0 && LatencyTimer::now() - _lastFrameTime > _stallTimeout * 1000LL)
+            return WaitResult::Stalled;
     }
-    else
+    return WaitResult::Stopped;
+}
+
+bool OpenNIApplication::recoverFromStall()
+{
+    LatencyTimer recoveryTimer;
+    ++_stalls;
+    qWarning() << qPrintable(tr("No frame received from the sensor for %1 ms, re-initializing it ...").arg(_stallTimeout));
+
+    while(!_stopRequested)
     {
-        // Calibration failed
-        qWarning() << qPrintable(QObject::tr("Calibration failed for user: %1").arg(userID));
-        if(calibrationStatus == XN_CALIBRATION_STATUS_MANUAL_ABORT)
-            qWarning() << qPrintable(QObject::tr("Manual abort occured, stop attempting to calibrate !"));
-        else // Restart the calibration process
-            app->startCalibration(userID);
+        _source->release();
+        if(_source->init() == XN_STATUS_OK && _source->start() == XN_STATUS_OK)
+        {
+            _lastFrameTime = LatencyTimer::now();
+            _stats->addSample(PipelineStage::StallRecovery, recoveryTimer.elapsed());
+            qDebug() << qPrintable(tr("Sensor re-initialized in %1 ms.").arg(recoveryTimer.elapsed() / 1000));
+            return true;
+        }
+
+        // Wait before the next attempt, or until the stop is requested
+        std::unique_lock<std::mutex> lock(_stopMutex);
+        _stopCondition.wait_for(lock, std::chrono::milliseconds(STALL_RETRY_INTERVAL),
+                                [this]() { return _stopRequested.load(); });
     }
+    return false;
 }
 
-OpenNIApplication::OpenNIApplication(int frequency, USBDevicePath camPath, USBDevicePath motorPath, QObject *parent) : QObject(parent)
+void OpenNIApplication::acquisitionLoop()
 {
-    _frequency = frequency;
+    uint32_t frameNumber = 0;
+    uint32_t generation = 0;
+    XnUInt32 lastSensorFrameID = 0;
+    const int depthWidth = _depthWidth;
+    const int depthHeight = _depthHeight;
+
+    while(true)
+    {
+        LatencyTimer stageTimer;
+
+        const WaitResult result = _stopRequested ? WaitResult::Stopped : waitForFrame();
+        if(result == WaitResult::Stalled)
+        {
+            // Stop the use of the last pose
+            AcquiredFrame invalidFrame;
+            invalidFrame.camInfo = OpenNIUtil::createInvalidCamInfo();
+            invalidFrame.generation = ++generation;
+            if(!_processingQueue.push(std::move(invalidFrame)))
+                _stats->stage(PipelineStage::Motion).addSkipped();
+
+            if(recoverFromStall())
+            {
+                lastSensorFrameID = 0;
+                continue;
+            }
+        }
+        if(result != WaitResult::Frame)
+            return;
 
-    _cameraPath = camPath;
-    _motorPath = motorPath;
+        _stats->addSample(PipelineStage::WaitFrame, stageTimer.restart());
+
+        AcquiredFrame frame;
+        frame.generation = generation;
+        OpenNIUtil::CameraInformations& camInfo = frame.camInfo;
+
+        camInfo.hostTimestamp = LatencyTimer::now();
+
+        // Use the sensor clock, so the time between two frames doesn't depend on our thread scheduling
+        camInfo.sensorFrameID = _source->frameID();
+        camInfo.sensorTimestamp = _source->timestamp();
+        camInfo.depthWidth = depthWidth;
+        camInfo.depthHeight = depthHeight;
+
+        // Check for missed frames
+        if(lastSensorFrameID != 0 && camInfo.sensorFrameID > lastSensorFrameID + 1)
+            _droppedSensorFrames += camInfo.sensorFrameID - lastSensorFrameID - 1;
+        lastSensorFrameID = camInfo.sensorFrameID;
+        camInfo.droppedSensorFrames = _droppedSensorFrames;
+
+        // Same skeletons as the previous frame: the rotation and the speed would not change,
+        // and the user would be seen as not moving
+        if(!_source->isUserDataNew())
+        {
+            ++_skippedFrames;
+            _stats->stage(PipelineStage::Extraction).addSkipped();
+            _stats->stage(PipelineStage::Motion).addSkipped();
+            _stats->stage(PipelineStage::Publication).addSkipped();
+            continue;
+        }
+
+        camInfo.frameNumber = ++frameNumber;
+
+        // The source overwrites its data at the next update, so everything is read now
+        frame.usersCount = _source->trackedUsers(frame.users, MAX_DETECTED_USERS);
+        for(int i=0; i < frame.usersCount; ++i)
+        {
+            frame.poses[i].timestamp = camInfo.sensorTimestamp;
+            _source->extractUser(frame.users[i], &frame.poses[i]);
+        }
+
+        // Copy the depth map once, consumers then read it without any synchronization
+        const XnDepthPixel *depthMap = _source->depthMap();
+        if(depthMap != nullptr)
+            frame.depthFrame = _depthFramePool.copy(depthMap, depthWidth, depthHeight, frameNumber);
+
+        _stats->addSample(PipelineStage::Extraction, stageTimer.restart());
+
+        if(!_processingQueue.push(std::move(frame)))
+            _stats->stage(PipelineStage::Motion).addSkipped();
+    }
 }
 
-OpenNIApplication::~OpenNIApplication()
+void OpenNIApplication::processingLoop()
 {
-    cleanup();
-    _kinectUSB->setLight(USBController::LightType::LED_BLINK_GREEN);
-    _kinectUSB->moveToAngle(0);
-    _kinectUSB->deleteLater();
+    AcquiredFrame frame;
+    uint32_t generation = 0;
+    uint64_t dropped = 0;
+
+    while(_processingQueue.pop(frame, &dropped))
+    {
+        _stats->stage(PipelineStage::Motion).addSkipped(dropped);
+        dropped = 0;
+
+        LatencyTimer stageTimer;
+
+        // The user IDs are not kept by a re-initialized source
+        if(frame.generation != generation)
+        {
+            _userTable.clear();
+            generation = frame.generation;
+        }
+
+        ProcessedFrame processed;
+        processed.camInfo = frame.camInfo;
+        processed.depthFrame = std::move(frame.depthFrame);
+
+        if(!frame.camInfo.invalid)
+        {
+            // Update all tracked users
+            _userTable.beginFrame();
+            for(int i=0; i < frame.usersCount; ++i)
+            {
+                const int row = _userTable.rowForUser(frame.users[i]);
+                // Too many users
+                if(row == -1)
+                    break;
+
+                _userTable.setPose(row, frame.poses[i]);
+            }
+            _userTable.endFrame();
+
+            _userTable.computeMotion(_rotationFilter, _speedFilter, _predictionHorizon);
+
+            // Publish the selected user, or the first tracked one
+            int selectedRow = _userTable.rowOf(_selectedUser);
+            if(selectedRow == -1 && _userTable.count() > 0)
+                selectedRow = 0;
+
+            OpenNIUtil::User& user = processed.camInfo.user;
+            if(selectedRow != -1)
+                user = _userTable.userAt(selectedRow);
+            else
+            {
+                user.id = 0;
+                user.isTracking = false;
+            }
+
+            processed.camInfo.trackedUsersCount = _userTable.count();
+            for(int row=0; row < _userTable.count(); ++row)
+                processed.camInfo.trackedUsers[row] = _userTable.idAt(row);
+
+            _stats->addSample(PipelineStage::Motion, stageTimer.elapsed());
+        }
+
+        if(!_publicationQueue.push(std::move(processed)))
+            _stats->stage(PipelineStage::Publication).addSkipped();
+    }
+
+    _publicationQueue.close();
 }
 
-// Private
-void OpenNIApplication::cleanup()
+void OpenNIApplication::publicationLoop()
 {
-    _depthGenerator.Release();
-    _userGenerator.Release();
+    ProcessedFrame frame;
+    uint64_t dropped = 0;
+
+    while(_publicationQueue.pop(frame, &dropped))
+    {
+        _stats->stage(PipelineStage::Publication).addSkipped(dropped);
+        dropped = 0;
 
-    _context.Release();
+        LatencyTimer stageTimer;
 
-    _mutex.lock();
-    _stopped = true;
-    _mutex.unlock();
+        if(!frame.depthFrame.isNull())
+            _depthFramePool.publish(frame.depthFrame);
+        // The pool keeps its own reference
+        frame.depthFrame = DepthFrame();
+
+        _lastCamInfo.store(frame.camInfo);
+        _started = true;
+
+        emit frameReady(frame.camInfo.frameNumber, frame.camInfo.user.isTracking);
+
+        _stats->addSample(PipelineStage::Publication, stageTimer.elapsed());
+        if(!frame.camInfo.invalid)
+            _stats->addSample(PipelineStage::Transit, LatencyTimer::now() - frame.camInfo.hostTimestamp);
+    }
 }
 
 // Getters
@@ -125,136 +294,132 @@ bool OpenNIApplication::isInitialized() const
     return _init;
 }
 
-bool OpenNIApplication::isStarted()
+bool OpenNIApplication::isStarted() const
 {
-    _mutex.lock();
-    const bool started = _started;
-    _mutex.unlock();
-    return started;
+    return _started;
 }
 
-bool OpenNIApplication::isStopped()
+bool OpenNIApplication::isStopped() const
 {
-    _mutex.lock();
-    const bool stopped = _stopped;
-    _mutex.unlock();
-    return stopped;
+    return _stopped;
 }
 
-OpenNIUtil::CameraInformations OpenNIApplication::lastCamInfo()
+OpenNIUtil::CameraInformations OpenNIApplication::lastCamInfo() const
 {
-    _mutex.lock();
-    OpenNIUtil::CameraInformations camInfo = _lastCamInfo;
-    _mutex.unlock();
-    return camInfo;
+    return _lastCamInfo.load();
 }
 
-// Setter
-void OpenNIApplication::requestStop()
+XnUserID OpenNIApplication::selectedUser() const
 {
-    _mutex.lock();
-    _stopRequested = true;
-    _mutex.unlock();
+    return _selectedUser;
+}
 
-    // Directly call cleanup() method if the application is not yet started
-    if(!isStarted())
-        cleanup();
+DepthFrame OpenNIApplication::lastDepthFrame()
+{
+    return _depthFramePool.latest();
 }
 
-// Init the app
-XnStatus OpenNIApplication::init()
+int OpenNIApplication::depthWidth() const
 {
-    if(_init)
-    {
-        qCritical() << qPrintable(tr("OpenNI already initialized !"));
-        return 1;
-    }
+    return _depthWidth;
+}
 
-    qDebug() << qPrintable(tr("Initializing OpenNI ..."));
+int OpenNIApplication::depthHeight() const
+{
+    return _depthHeight;
+}
 
-    XnStatus status = XN_STATUS_OK;
+int OpenNIApplication::stalls() const
+{
+    return _stalls;
+}
 
-    // Init the context
-    status = _context.Init();
-    CHECK_ERROR(status, tr("Context Init", "on error"));
+bool OpenNIApplication::waitForStopped(const int timeout)
+{
+    std::unique_lock<std::mutex> lock(_stopMutex);
+    return _stopCondition.wait_for(lock, std::chrono::milliseconds(timeout),
+                                   [this]() { return _stopped.load(); });
+}
 
-    // List all sensors
-    xn::NodeInfoList devicesList;
-    status = _context.EnumerateProductionTrees(XN_NODE_TYPE_DEVICE, nullptr, devicesList);
-    CHECK_ERROR(status, tr("Search available devices", "on error"));
+// Setters
+void OpenNIApplication::selectUser(const XnUserID userID)
+{
+    _selectedUser = userID;
+}
 
-    // Check if the specified device in constructor exists
-    bool found = false;
-    for(xn::NodeInfoList::Iterator it = devicesList.Begin(); it != devicesList.End(); ++it)
+void OpenNIApplication::requestStop()
+{
+    // The source is only used by the thread of start(), so nothing is released here
     {
-        // A sensor was found, add to the list
-        if((*it).GetCreationInfo() == _cameraPath.toString())
-        {
-            xn::NodeInfo nodeInfo = *it;
-            found = true;
-
-            qDebug() << qPrintable(tr("Creating device: %1").arg(_cameraPath.toString()));
-
-            status = _context.CreateProductionTree(nodeInfo, _device);
-            CHECK_ERROR(status, tr("Create device", "on error"));
-
-            // Create the query for the current node
-            xn::Query query;
-            query.AddNeededNode(nodeInfo.GetInstanceName());
-
-            // Create the depth generator
-            status = _context.CreateAnyProductionTree(XN_NODE_TYPE_DEPTH, &query, _depthGenerator);
-            CHECK_ERROR(status, tr("Create depth generator", "on error"));
+        std::lock_guard<std::mutex> lock(_stopMutex);
+        _stopRequested = true;
+    }
+    _stopCondition.notify_all();
+}
 
-            // Create the user generator
-            status = _context.CreateAnyProductionTree(XN_NODE_TYPE_USER, &query, _userGenerator);
-            CHECK_ERROR(status, tr("Create user generator", "on error"));
+void OpenNIApplication::stop()
+{
+    requestStop();
+    cleanup();
+}
 
-            // Register all users callbacks
-            status = _userGenerator.RegisterUserCallbacks(&newUserCallback, &lostUserCallback, this, _userCBHandler);
-            CHECK_ERROR(status, tr("Register to user callbacks", "on error"));
-            status = _userGenerator.GetSkeletonCap().RegisterToCalibrationStart(&calibrationStartCallback, this, _calibrationStartCBHandler);
-            CHECK_ERROR(status, tr("Register to calibration start", "on error"));
-            status = _userGenerator.GetSkeletonCap().RegisterToCalibrationComplete(&calibrationEndCallback, this, _calibrationEndCBHandler);
-            CHECK_ERROR(status, tr("Register to calibration complete", "on error"));
+void OpenNIApplication::setStallTimeout(const int timeout)
+{
+    _stallTimeout = timeout;
+}
 
-            // Check if the user generator support skeleton
-            if(!_userGenerator.IsCapabilitySupported(XN_CAPABILITY_SKELETON))
-            {
-                qCritical() << qPrintable(tr("Supplied user generator doesn't support skeleton capability."));
-                return 20;
-            }
-            // Check if the user generator need a pose for skeleton detection
-            if(_userGenerator.GetSkeletonCap().NeedPoseForCalibration())
-            {
-                qCritical() << qPrintable(tr("Pose calibration required but not supported by this program."));
-                return 30;
-            }
+void OpenNIApplication::setDropPolicies(const DropPolicy processing, const DropPolicy publication)
+{
+    _processingQueue.setPolicy(processing);
+    _publicationQueue.setPolicy(publication);
+}
 
-            // Set the skeleton profile
-            _userGenerator.GetSkeletonCap().SetSkeletonProfile(XN_SKEL_PROFILE_ALL);
+void OpenNIApplication::setFilters(const FilterSettings& rotation, const FilterSettings& speed)
+{
+    _rotationFilter = rotation;
+    _speedFilter = speed;
+}
 
-            // Create the usb controller
-            _kinectUSB = new USBController(this);
-            _kinectUSB->init(_motorPath);
-            // Move the kinect to the angle 0 at startup
-            if(_kinectUSB->initialized())
-            {
-                _kinectUSB->moveToAngle(0);
-                _kinectUSB->setLight(USBController::LightType::LED_GREEN);
-            }
+void OpenNIApplication::setPredictionHorizon(const int64_t horizon)
+{
+    _predictionHorizon = horizon;
+}
 
-            // Exit the for loop
-            break;
-        }
-    }
+void OpenNIApplication::reset(SensorSource *source)
+{
+    cleanup();
+    delete _source;
+    _source = source;
+
+    _init = false;
+    _started = false;
+    _stopRequested = false;
+    _userTable = UserTable();
+    _droppedSensorFrames = 0;
+    _skippedFrames = 0;
+    _stalls = 0;
+
+    std::lock_guard<std::mutex> lock(_stopMutex);
+    _stopped = false;
+}
 
-    if(!found)
+// Init the app
+XnStatus OpenNIApplication::init()
+{
+    if(_init)
     {
-        qCritical() << qPrintable(tr("The specified device doesn't exist !"));
-        return 4;
+        qCritical() << qPrintable(tr("OpenNI already initialized !"));
+        return 1;
     }
 
+    // Errors are reported by the source
+    const XnStatus status = _source->init();
+    if(status != XN_STATUS_OK)
+        return status;
+
+    _depthWidth = _source->depthWidth();
+    _depthHeight = _source->depthHeight();
+
     _init = true;
     return status;
 }
@@ -269,154 +434,44 @@ XnStatus OpenNIApplication::start()
 
     qDebug() << qPrintable(tr("Starting OpenNI main loop ..."));
 
-    const XnStatus status = _context.StartGeneratingAll();
-    CHECK_ERROR(status, tr("Start Generating", "on error"));
-
-    // Start the frame loop
-    bool firstLoop = true;
-
-    while(true)
+    // Stopped before the start (e.g. during init())
+    if(_stopRequested)
     {
-        _mutex.lock();
-        if(_stopRequested)
-        {
-            _mutex.unlock();
-            cleanup();
-            break;
-        }
-        _mutex.unlock();
-
-        // Get the previous user data
-        _mutex.lock();
-        const OpenNIUtil::User previousUser = _lastCamInfo.user;
-        _mutex.unlock();
-        OpenNIUtil::CameraInformations camInfo;
-
-        _context.WaitAnyUpdateAll();
-
-        camInfo.depthData = const_cast<XnDepthPixel *>(_depthGenerator.GetDepthMap());
-
-        // Try to get 5 users, but only save the first tracked
-        XnUInt16 usersCount = 5;
-        XnUserID usersArray[usersCount];
-        _userGenerator.GetUsers(usersArray, usersCount);
-        // Get the first tracked user
-        XnUserID firstTrackingID = 0;
-        for(XnUserID id : usersArray)
-        {
-            if(_userGenerator.GetSkeletonCap().IsTracking(id))
-            {
-                firstTrackingID = id;
-                break;
-            }
-        }
-
-        // Set the current user
-        OpenNIUtil::User user;
-        if(firstTrackingID != 0)
-        {
-            user.id = firstTrackingID;
-            user.isTracking = true;
-
-            user.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+        cleanup();
+        return XN_STATUS_OK;
+    }
 
-            user.leftPart.hip = createJoint(XN_SKEL_LEFT_HIP, user.id);
-            user.leftPart.knee = createJoint(XN_SKEL_LEFT_KNEE, user.id);
-            user.leftPart.foot = createJoint(XN_SKEL_LEFT_FOOT, user.id);
-            user.leftPart.shoulder = createJoint(XN_SKEL_LEFT_SHOULDER, user.id);
-            user.rightPart.hip = createJoint(XN_SKEL_RIGHT_HIP, user.id);
-            user.rightPart.knee = createJoint(XN_SKEL_RIGHT_KNEE, user.id);
-            user.rightPart.foot = createJoint(XN_SKEL_RIGHT_FOOT, user.id);
-            user.rightPart.shoulder = createJoint(XN_SKEL_RIGHT_SHOULDER, user.id);
+    // A stop requested meanwhile is seen by the frame loop
+    const XnStatus status = _source->start();
+    if(status != XN_STATUS_OK)
+        return status;
 
-            user.torsoJoint = createJoint(XN_SKEL_TORSO, user.id);
+    _lastFrameTime = LatencyTimer::now();
 
-            user.previousLeftPart = previousUser.leftPart;
-            user.previousRightPart = previousUser.rightPart;
+    // The acquisition runs in this thread
+    _processingQueue.reopen();
+    _publicationQueue.reopen();
+    std::thread processingThread(&OpenNIApplication::processingLoop, this);
+    std::thread publicationThread(&OpenNIApplication::publicationLoop, this);
 
-            OpenNIUtil::rotationForUser(_frequency, previousUser.rotation, &user);
+    acquisitionLoop();
 
-            // Only compute the walk speed if we are not in the first frame
-            if(!firstLoop)
-            {
-                user.walkSpeed = OpenNIUtil::walkSpeedForUser(_frequency, user, previousUser.timestamp, previousUser.walkSpeed);
-                if(previousUser.walkSpeed != -1 && previousUser.walkSpeed <= MIN_COMPUTED_WALKSPEED)
-                    user.numberOfFramesWithoutMove = previousUser.numberOfFramesWithoutMove + 1;
-                else
-                    user.numberOfFramesWithoutMove = 0;
-            }
-        }
-        else
-        {
-            user.id = 0;
-            user.isTracking = false;
-        }
-
-        _mutex.lock();
-        _lastCamInfo = camInfo;
-        _lastCamInfo.user = user;
-        _mutex.unlock();
-
-        if(firstLoop)
-        {
-            _mutex.lock();
-            firstLoop = false;
-            _started = true;
-            _mutex.unlock();
-        }
-    }
+    // The frames already acquired go through the other stages before they exit
+    _processingQueue.close();
+    processingThread.join();
+    publicationThread.join();
 
+    // The app can be deleted as soon as it is stopped, so no member is used after this call
+    cleanup();
     return status;
 }
 
-OpenNIUtil::Joint OpenNIApplication::createJoint(const XnSkeletonJoint jointType, const XnUserID userID)
-{
-    OpenNIUtil::Joint joint;
-    joint.type = jointType;
-    joint.isActive = _userGenerator.GetSkeletonCap().IsJointActive(jointType);
-    if(joint.isActive)
-    {
-        // Get the position info
-        _userGenerator.GetSkeletonCap().GetSkeletonJointPosition(userID, jointType, joint.info);
-        // Get the projectives positions
-        _depthGenerator.ConvertRealWorldToProjective(1, &joint.info.position, &joint.projectivePos);
-    }
-    return joint;
-}
-
 void OpenNIApplication::moveToAngle(const int angle)
 {
-    if(_kinectUSB != nullptr && _kinectUSB->initialized())
-        _kinectUSB->moveToAngle(angle);
+    _source->moveToAngle(angle);
 }
 
 void OpenNIApplication::setLight(const USBController::LightType type)
 {
-    if(_kinectUSB != nullptr && _kinectUSB->initialized())
-        _kinectUSB->setLight(type);
+    _source->setLight(type);
 }
-
-XnStatus OpenNIApplication::startCalibration(const XnUserID userID)
-{
-    _mutex.lock();
-    if(_started)
-    {
-        _mutex.unlock();
-        return _userGenerator.GetSkeletonCap().RequestCalibration(userID, TRUE);
-    }
-    _mutex.unlock();
-    return 100;
-}
-
-XnStatus OpenNIApplication::startTracking(const XnUserID userID)
-{
-    _mutex.lock();
-    if(_started)
-    {
-        _mutex.unlock();
-        return _userGenerator.GetSkeletonCap().StartTracking(userID);
-    }
-    _mutex.unlock();
-    return 101;
-}
-
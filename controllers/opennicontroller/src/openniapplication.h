@@ -19,41 +19,132 @@
 #ifndef OPENNIAPPLICATION_H
 #define OPENNIAPPLICATION_H
 
-#include <ni/XnOpenNI.h>
-#include <ni/XnCodecIDs.h>
-#include <map>
+#include <ni/XnTypes.h>
+#include <atomic>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
 
 #include <QObject>
 
 #include "openniutil.h"
 #include "usbcontroller.h"
+#include "seqlock.h"
+#include "depthframepool.h"
+#include "sensorsource.h"
+#include "usertable.h"
+#include "pipelinequeue.h"
+#include "core/latencystats.h"
 
-// This class is a bridge between the program and the OpenNI API.
+// Maximum time the frame loop waits for a new frame before it checks the stop request
+// and the stall timeout (in ms), the wait ends as soon as a frame is available
+#define FRAME_WAIT_TIMEOUT 50
+// Default maximum time without frame before the source is re-initialized (in ms)
+#define DEFAULT_STALL_TIMEOUT 1000
+// Interval between two attempts to re-initialize a stalled source (in ms)
+#define STALL_RETRY_INTERVAL 1000
+// Capacity of the queues between the stages of the frame pipeline
+#define PIPELINE_QUEUE_CAPACITY 4
+// Maximum number of depth frames held by the pipeline at the same time
+// (in the queues, and one in each stage)
+#define PIPELINE_MAX_DEPTH_FRAMES (2 * PIPELINE_QUEUE_CAPACITY + 3)
+
+// Stages measured in the OpenNI pipeline
+namespace PipelineStage
+{
+    enum
+    {
+        WaitFrame = 0,
+        Extraction,
+        Motion,
+        Publication,
+        // Time between the frame reception and its publication
+        Transit,
+        // Time between the frame reception and the read of its data
+        DataAge,
+        // Drawing of the image in the render worker (skipped: frames dropped while it's busy)
+        Render,
+        // Upload of the image in the GUI thread
+        Display,
+        // Time to re-initialize the source after a stall
+        StallRecovery,
+
+        Count
+    };
+}
+
+typedef LatencyStats<PipelineStage::Count> PipelineStats;
+
+// This class is a bridge between the program and the sensor (see SensorSource).
 // When started, you can retrieve the last informations using lastCamInfo()
+// (from any thread, it never blocks the frame loop).
+// The frameReady() signal is emitted each time new informations are available.
+//
+// The frames go through a pipeline of three stages, each one in its own thread:
+// - acquisition (the thread calling start()): wait for the frame, read the skeletons and copy the depth map
+// - processing: update the users, compute the rotation and the speed, select the user
+// - publication: publish the informations and the depth map, emit frameReady()
+// The stages are connected by bounded queues (see PipelineQueue), so a slow stage
+// only limits the throughput, not the other stages.
+//
+// If the source doesn't give any frame during the stall timeout, invalid informations
+// are published (so the last pose is not used anymore) and the source is re-initialized
+// in the frame loop, until it works again or the stop is requested.
 class OpenNIApplication: public QObject
 {
         Q_OBJECT
     public:
         // Nothing is created in the constructor.
         // Please call init() to start the process
-        OpenNIApplication(int frequency, USBDevicePath camPath, USBDevicePath motorPath, QObject *parent = nullptr);
+        // The app takes the ownership of the source
+        // The stats object must outlive the app
+        OpenNIApplication(SensorSource *source, PipelineStats *stats, QObject *parent = nullptr);
         ~OpenNIApplication();
 
         // Check if the app is initialized
         bool isInitialized() const;
 
         // Check if the app is started
-        bool isStarted();
+        bool isStarted() const;
 
         // Check if the app is stopped
-        bool isStopped();
+        bool isStopped() const;
 
-        // Request the stop of the app
+        // Request the stop of the app, can be called from any thread
+        // The frame loop is woken up, exits as soon as possible and releases the source.
+        // If the loop isn't running yet, start() returns immediately
         void requestStop();
 
+        // Request the stop and release the source now
+        // Must be called from the thread of start(), while the frame loop is not running
+        void stop();
+
+        // Block until the app is stopped or the timeout (in ms) is reached
+        // Return true if the app is stopped
+        bool waitForStopped(const int timeout);
+
+        // Replace the source and go back to the state before init()
+        // Must not be called while the frame loop is running
+        void reset(SensorSource *source);
+
+        // Maximum time without frame (in ms) before the source is re-initialized, 0 to disable
+        // Must be called before start()
+        void setStallTimeout(const int timeout);
+        // Policies of the input queues of the processing and publication stages
+        // Must be called before start()
+        void setDropPolicies(const DropPolicy processing, const DropPolicy publication);
+        // Smoothing of the rotation and of the walk speed
+        // Must be called before start()
+        void setFilters(const FilterSettings& rotation, const FilterSettings& speed);
+        // Time (in µs) the rotation and the walk speed are extrapolated by the readers,
+        // used to measure the error of the prediction
+        // Must be called before start()
+        void setPredictionHorizon(const int64_t horizon);
+        // Number of stalls detected since the start
+        int stalls() const;
+
         // Initialise the app
-        // Must be call only one time
+        // Must be call only one time (or after reset())
         XnStatus init();
 
         // Start the application
@@ -62,11 +153,22 @@ class OpenNIApplication: public QObject
         // To exit, please call the requestStop() function
         XnStatus start();
 
-        // Don't call these functions directly, they are usually called from the Callbacks methods
-        XnStatus startCalibration(const XnUserID userID);
-        XnStatus startTracking(const XnUserID userID);
+        // Select the user stored in the camera informations
+        // If 0, the first tracked user is used
+        void selectUser(const XnUserID userID);
+        XnUserID selectedUser() const;
 
-        OpenNIUtil::CameraInformations lastCamInfo();
+        OpenNIUtil::CameraInformations lastCamInfo() const;
+        // The returned frame stays valid as long as the handle is kept
+        DepthFrame lastDepthFrame();
+
+        // Size of the depth maps of the source (only valid once initialized)
+        int depthWidth() const;
+        int depthHeight() const;
+
+    signals:
+        // Emitted from the publication thread, after the informations are published
+        void frameReady(quint32 frameNumber, bool userTracked);
 
     public slots:
         // These functions are only available if you are using a Kinect sensor
@@ -75,39 +177,91 @@ class OpenNIApplication: public QObject
 
     private:
 
-        std::mutex _mutex;
+        std::atomic<bool> _init{false};
+        std::atomic<bool> _started{false};
+        std::atomic<bool> _stopped{false};
+        std::atomic<bool> _stopRequested{false};
+
+        std::atomic<XnUserID> _selectedUser{0};
+
+        std::atomic<int> _depthWidth{DEFAULT_DEPTH_MAP_WIDTH};
+        std::atomic<int> _depthHeight{DEFAULT_DEPTH_MAP_HEIGHT};
+
+        // Used for the stop handshake
+        std::mutex _stopMutex;
+        std::condition_variable _stopCondition;
+
+        // Written only by the frame loop, read by the GUI and the Bluetooth timers
+        SeqLock<OpenNIUtil::CameraInformations> _lastCamInfo;
+        // Copies of the depth maps, since OpenNI overwrites its buffer at each update
+        DepthFramePool _depthFramePool;
+
+        PipelineStats *_stats;
+
+        SensorSource *_source;
 
-        bool _init = false;
-        bool _started = false;
-        bool _stopped = false;
-        bool _stopRequested = false;
+        // Data passed from the acquisition to the processing
+        struct AcquiredFrame
+        {
+            // Without the users
+            OpenNIUtil::CameraInformations camInfo;
+            // Increased each time the source is re-initialized
+            uint32_t generation = 0;
 
-        OpenNIUtil::CameraInformations _lastCamInfo;
+            int usersCount = 0;
+            XnUserID users[MAX_DETECTED_USERS];
+            OpenNIUtil::User poses[MAX_DETECTED_USERS];
 
-        int _frequency;
+            DepthFrame depthFrame;
+        };
 
-        USBDevicePath _cameraPath;
-        USBDevicePath _motorPath;
+        // Data passed from the processing to the publication
+        struct ProcessedFrame
+        {
+            OpenNIUtil::CameraInformations camInfo;
+            DepthFrame depthFrame;
+        };
 
-        USBController *_kinectUSB;
+        PipelineQueue<AcquiredFrame, PIPELINE_QUEUE_CAPACITY> _processingQueue;
+        PipelineQueue<ProcessedFrame, PIPELINE_QUEUE_CAPACITY> _publicationQueue;
 
-        xn::Context _context;
+        // Only used in the processing stage
+        UserTable _userTable;
+        FilterSettings _rotationFilter;
+        FilterSettings _speedFilter;
+        int64_t _predictionHorizon = DEFAULT_PREDICTION_HORIZON * 1000;
 
-        xn::ProductionNode _device;
-        xn::NodeInfo _nodeInfo = xn::NodeInfo(nullptr);
+        // Only used in the acquisition stage
+        uint32_t _droppedSensorFrames = 0;
+        int _stallTimeout = 0;
+        std::atomic<int> _stalls{0};
+        // Host time (in µs) of the last frame, or of the (re)start of the source
+        int64_t _lastFrameTime = 0;
+        // Frames without new skeleton data
+        uint64_t _skippedFrames = 0;
 
-        // Generators
-        xn::DepthGenerator _depthGenerator;
-        xn::UserGenerator _userGenerator;
+        enum class WaitResult
+        {
+            Frame,
+            Stalled,
+            // Stop requested, or no more frames
+            Stopped
+        };
 
-        // Callbacks handler
-        XnCallbackHandle _userCBHandler;
-        XnCallbackHandle _calibrationStartCBHandler;
-        XnCallbackHandle _calibrationEndCBHandler;
+        // Stages of the pipeline
+        // Each one returns when the previous one is finished
+        void acquisitionLoop();
+        void processingLoop();
+        void publicationLoop();
 
-        OpenNIUtil::Joint createJoint(const XnSkeletonJoint jointType, const XnUserID userID);
+        // Wait until the source has a new frame and update it
+        WaitResult waitForFrame();
+        // Re-initialize the source
+        // Return false if the stop was requested meanwhile
+        bool recoverFromStall();
 
-        // Cleanup all OpenNI objects
+        // Release the source
+        // Can be called multiple times
         void cleanup();
 };
 
@@ -49,7 +49,8 @@ class OpenNIController: public ControllerInterface
 
         void start()
         {
-            _widget = new OpenNIControllerWidget(dataFrequency());
+            _widget = new OpenNIControllerWidget(dataFrequency(), dataPolling(), options());
+            connect(_widget, &OpenNIControllerWidget::newData, this, &ControllerInterface::dataAvailable);
         }
 
         QWidget *widget()
@@ -74,6 +75,32 @@ class OpenNIController: public ControllerInterface
         {
             return _widget->specialCode();
         }
+
+        QList<int> userIDs()
+        {
+            return _widget->userIDs();
+        }
+
+        bool selectUser(const int id)
+        {
+            _widget->selectUser(id);
+            return true;
+        }
+
+        QString statistics()
+        {
+            return _widget->statistics();
+        }
+
+        void dataSent()
+        {
+            _widget->dataSent();
+        }
+
+        bool hasDataNotification() const
+        {
+            return true;
+        }
 };
 
 #endif // OPENNICONTROLLER_H
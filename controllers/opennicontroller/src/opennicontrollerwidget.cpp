@@ -22,11 +22,22 @@
 #include <QVBoxLayout>
 #include <QFormLayout>
 #include <QLabel>
+#include <QHBoxLayout>
+#include <QFileDialog>
+#include <QSignalBlocker>
+#include <QRegularExpression>
 
 #define CLOCKWISE_BUTTON_ID 12
 #define COUNTERCLOCKWISE_BUTTON_ID 20
 
-OpenNIControllerWidget::OpenNIControllerWidget(unsigned int frequency, QWidget *parent): QWidget(parent)
+const QString optionDepthPaletteStr = "depthPalette";
+const QString optionDepthRangeStr = "depthRange";
+
+const QString paletteGrayStr = "gray";
+const QString paletteTurboStr = "turbo";
+const QString paletteNearRangeStr = "nearRange";
+
+OpenNIControllerWidget::OpenNIControllerWidget(unsigned int frequency, bool polling, const QVariantMap& options, QWidget *parent): QWidget(parent)
 {
     _viewer = new OpenCVWidget(this);
 
@@ -44,27 +55,133 @@ OpenNIControllerWidget::OpenNIControllerWidget(unsigned int frequency, QWidget *
         _openniWorker->setMotorAngle(angle);
     });
 
+    // The automatic tilt replaces the manual orientation
+    _autoTiltCheckBox = new QCheckBox(tr("Automatic"), this);
+    connect(_autoTiltCheckBox, &QCheckBox::toggled, this, [this](bool checked) {
+        _spinBox->setEnabled(!checked);
+        _openniWorker->setAutoTilt(checked);
+    });
+
+    QHBoxLayout *layoutMotor = new QHBoxLayout();
+    layoutMotor->addWidget(_spinBox);
+    layoutMotor->addWidget(_autoTiltCheckBox);
+    layoutMotor->addStretch(1);
+
     QFormLayout *layoutSensor = new QFormLayout();
     mainLayout->addLayout(layoutSensor);
-    layoutSensor->addRow(QString("<b>%1</b>").arg(tr("Motor orientation :")), _spinBox);
+    layoutSensor->addRow(QString("<b>%1</b>").arg(tr("Motor orientation :")), layoutMotor);
+
+    _recordButton = new QPushButton(tr("Record the session"), this);
+    _recordButton->setCheckable(true);
+    connect(_recordButton, &QPushButton::toggled, this, &OpenNIControllerWidget::toggleRecording);
+
+    _recordDepthCheckBox = new QCheckBox(tr("With depth maps"), this);
+
+    QHBoxLayout *layoutRecord = new QHBoxLayout();
+    layoutRecord->addWidget(_recordButton);
+    layoutRecord->addWidget(_recordDepthCheckBox);
+    layoutRecord->addStretch(1);
+    layoutSensor->addRow(QString("<b>%1</b>").arg(tr("Recording :")), layoutRecord);
+
+    // The item data are the values of DepthPalette
+    _paletteComboBox = new QComboBox(this);
+    _paletteComboBox->addItem(tr("Gray"), static_cast<int>(DepthPalette::Gray));
+    _paletteComboBox->addItem(tr("Colors"), static_cast<int>(DepthPalette::Turbo));
+    _paletteComboBox->addItem(tr("Near range"), static_cast<int>(DepthPalette::NearRange));
+
+    const QString palette = options.value(optionDepthPaletteStr).toString();
+    if(palette == paletteTurboStr)
+        _paletteComboBox->setCurrentIndex(1);
+    else if(palette == paletteNearRangeStr)
+        _paletteComboBox->setCurrentIndex(2);
+    else if(!palette.isEmpty() && palette != paletteGrayStr)
+        qWarning() << qPrintable(tr("Invalid value for the option %1: %2").arg(optionDepthPaletteStr, palette));
+
+    const QString range = options.value(optionDepthRangeStr).toString();
+    if(!range.isEmpty())
+    {
+        const QRegularExpressionMatch match = QRegularExpression("^(\\d+)-(\\d+)$").match(range);
+        if(match.hasMatch() && match.captured(1).toInt() < match.captured(2).toInt())
+        {
+            _depthNear = match.captured(1).toInt();
+            _depthFar = match.captured(2).toInt();
+        }
+        else
+            qWarning() << qPrintable(tr("Invalid depth range: %1, the range of the palette is used.").arg(range));
+    }
 
-    _openniWorker = new OpenNIWorker(frequency);
+    QHBoxLayout *layoutDepth = new QHBoxLayout();
+    layoutDepth->addWidget(_paletteComboBox);
+    layoutDepth->addStretch(1);
+    layoutSensor->addRow(QString("<b>%1</b>").arg(tr("Depth view :")), layoutDepth);
+
+    _openniWorker = new OpenNIWorker(options);
+
+    _autoTiltCheckBox->setChecked(_openniWorker->isAutoTiltEnabled());
+    _spinBox->setEnabled(!_openniWorker->isAutoTiltEnabled());
+    connect(_openniWorker, &OpenNIWorker::motorAngleChanged, this, [this](int angle) {
+        const QSignalBlocker blocker(_spinBox);
+        _spinBox->setValue(angle);
+    });
 
     connect(&_openniThread, &QThread::finished, _openniWorker, &QObject::deleteLater);
     connect(&_openniThread, &QThread::started, _openniWorker, &OpenNIWorker::launch);
 
+    // Deleted in the destructor, once the OpenNI thread can't request a render anymore
+    _renderWorker = new RenderWorker(_openniWorker);
+    connect(_renderWorker, &RenderWorker::imageReady, this, &OpenNIControllerWidget::showImage);
+
+    updatePalette();
+    connect(_paletteComboBox, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
+            this, &OpenNIControllerWidget::updatePalette);
+
+    if(polling)
+    {
+        // Start a timer
+        _timerID = startTimer(1000/frequency, Qt::PreciseTimer);
+    }
+    else
+    {
+        // The data are notified first, so they are sent before the image is drawn
+        connect(_openniWorker, &OpenNIWorker::frameReady, this, [this](quint32 /*frameNumber*/, bool userTracked) {
+            if(userTracked || _userTracked)
+                emit newData();
+            _userTracked = userTracked;
+        });
+        // Requested directly from the publication thread, it never blocks
+        connect(_openniWorker, &OpenNIWorker::frameReady, _renderWorker, [this]() {
+            _renderWorker->requestRender();
+        }, Qt::DirectConnection);
+    }
+
+    _renderWorker->moveToThread(&_renderThread);
+    _renderThread.start();
+
     _openniWorker->moveToThread(&_openniThread);
     _openniThread.start();
-
-    // Start a timer
-    _timerID = startTimer(1000/frequency, Qt::PreciseTimer);
 }
 
 OpenNIControllerWidget::~OpenNIControllerWidget()
 {
+    // Stopped first, the render worker reads the OpenNI worker
+    // The threads must be finished before their QThread is destroyed, so a slow stop is only reported
+    _renderThread.quit();
+    if(!_renderThread.wait(OPENNI_STOP_TIMEOUT))
+    {
+        qCritical() << qPrintable(tr("The render thread didn't stop after %1 ms !").arg(OPENNI_STOP_TIMEOUT));
+        _renderThread.wait();
+    }
+
     _openniWorker->requestStop();
     _openniThread.quit();
-    _openniThread.wait();
+    if(!_openniThread.wait(OPENNI_STOP_TIMEOUT))
+    {
+        qCritical() << qPrintable(tr("The OpenNI thread didn't stop after %1 ms !").arg(OPENNI_STOP_TIMEOUT));
+        _openniThread.wait();
+    }
+
+    // The publication thread can't request a render anymore
+    delete _renderWorker;
 }
 
 // Getters
@@ -83,17 +200,75 @@ int OpenNIControllerWidget::specialCode() const
     return _openniWorker->specialCode();
 }
 
+void OpenNIControllerWidget::dataSent()
+{
+    _openniWorker->dataSent();
+}
+
+QList<int> OpenNIControllerWidget::userIDs() const
+{
+    return _openniWorker->userIDs();
+}
+
+void OpenNIControllerWidget::selectUser(const int userID)
+{
+    _openniWorker->selectUser(userID);
+}
+
+QString OpenNIControllerWidget::statistics() const
+{
+    return _openniWorker->stats().report() + "\n" + tr("Sensor stalls: %1").arg(_openniWorker->stalls());
+}
+
 // Re-implemented protected method
 void OpenNIControllerWidget::timerEvent(QTimerEvent *event)
 {
     if(event->timerId() == _timerID)
+        _renderWorker->requestRender();
+}
+
+// Private slots
+void OpenNIControllerWidget::toggleRecording(bool record)
+{
+    if(record)
     {
-        // Output the image
-        OpenNIUtil::CameraInformations camInfo = _openniWorker->camInfo();
-        if(!camInfo.invalid)
+        const QString path = QFileDialog::getSaveFileName(this, tr("Record the session"), QString(),
+                                                          tr("Sessions (*.vrcs)"));
+        if(path.isEmpty() || !_openniWorker->startRecording(path, _recordDepthCheckBox->isChecked()))
         {
-            cv::Mat image = OpenCVUtil::drawOpenNIData(camInfo);
-            _viewer->showImage(image);
+            const QSignalBlocker blocker(_recordButton);
+            _recordButton->setChecked(false);
+            return;
         }
     }
+    else
+        _openniWorker->stopRecording();
+
+    _recordButton->setText(record ? tr("Stop the recording") : tr("Record the session"));
+    _recordDepthCheckBox->setEnabled(!record);
+}
+
+void OpenNIControllerWidget::updatePalette()
+{
+    const DepthPalette palette = static_cast<DepthPalette>(_paletteComboBox->currentData().toInt());
+
+    int nearDepth = _depthNear;
+    int farDepth = _depthFar;
+    if(nearDepth == -1)
+        DepthColorTable::defaultRange(palette, &nearDepth, &farDepth);
+
+    // The table is owned by the render thread
+    QMetaObject::invokeMethod(_renderWorker, "setPalette", Qt::QueuedConnection,
+                              Q_ARG(int, static_cast<int>(palette)), Q_ARG(int, nearDepth), Q_ARG(int, farDepth));
+}
+
+void OpenNIControllerWidget::showImage(std::shared_ptr<const cv::Mat> image)
+{
+    LatencyTimer displayTimer;
+
+    // The viewer holds the image until it's uploaded
+    _viewer->showImage(std::move(image));
+    _renderWorker->imageShown();
+
+    _openniWorker->stats().addSample(PipelineStage::Display, displayTimer.elapsed());
 }
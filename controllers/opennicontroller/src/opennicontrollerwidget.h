@@ -22,26 +22,51 @@
 #include "opencvwidget.h"
 #include "opencvutil.h"
 #include "openniworker.h"
+#include "renderworker.h"
 
 #include <QSpinBox>
+#include <QPushButton>
+#include <QCheckBox>
+#include <QComboBox>
 #include <QThread>
 
 // Simple widget containing the image viewer
-// This viewer also launch the OpenNI thread
+// This viewer also launch the OpenNI thread and the render thread (see RenderWorker)
+// The image is drawn when the OpenNI thread has a new frame,
+// or at the specified frequency if polling is set
 class OpenNIControllerWidget: public QWidget
 {
         Q_OBJECT
     public:
-        explicit OpenNIControllerWidget(unsigned int frequency, QWidget *parent = nullptr);
+        // See OpenNIWorker for the supported options
+        OpenNIControllerWidget(unsigned int frequency, bool polling, const QVariantMap& options, QWidget *parent = nullptr);
         ~OpenNIControllerWidget();
 
         int orientationValue() const;
         int walkSpeedValue() const;
         int specialCode() const;
+        // See ControllerInterface::dataSent()
+        void dataSent();
+
+        QList<int> userIDs() const;
+        void selectUser(const int userID);
+
+        // Report of the latencies of the pipeline
+        QString statistics() const;
+
+    signals:
+        // Emitted when a frame with a tracked user is available
+        // (or when the user has just been lost)
+        void newData();
 
     protected:
         void timerEvent(QTimerEvent *event);
 
+    private slots:
+        void showImage(std::shared_ptr<const cv::Mat> image);
+        void toggleRecording(bool record);
+        void updatePalette();
+
     private:
 
         OpenCVWidget *_viewer;
@@ -49,9 +74,23 @@ class OpenNIControllerWidget: public QWidget
         OpenNIWorker *_openniWorker;
         QThread _openniThread;
 
+        RenderWorker *_renderWorker;
+        QThread _renderThread;
+
         QSpinBox *_spinBox;
+        QCheckBox *_autoTiltCheckBox;
+
+        QPushButton *_recordButton;
+        QCheckBox *_recordDepthCheckBox;
+
+        QComboBox *_paletteComboBox;
+        // Range of the palette (in mm), -1 for the default one
+        int _depthNear = -1;
+        int _depthFar = -1;
 
         int _timerID = 0;
+
+        bool _userTracked = false;
 };
 
 #endif // OPENNICONTROLLERWIDGET_H
@@ -0,0 +1,469 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "opennisensorsource.h"
+
+#include <QString>
+#include <QDebug>
+#include <QFile>
+
+#include <chrono>
+#include <vector>
+
+// These defines are used to avoid to much code repetition
+#define CHECK_ERROR(retVal, what)                                                                                                                  \
+    if(retVal != XN_STATUS_OK)                                                                                                                     \
+    {                                                                                                                                              \
+        qCritical() << qPrintable(QObject::tr("%1 failed: %2", "%1 is what failed and %2 is the error from OpenNI SDK.").arg(what).arg(xnGetStatusString(retVal)));   \
+        return retVal;                                                                                                                             \
+    }
+
+#define GET_OPENNI_SOURCE(cookie, source)                                              \
+    source = static_cast<OpenNISensorSource*>(cookie);                                 \
+    if(source == nullptr)                                                              \
+    {                                                                                  \
+        qCritical() << qPrintable(QObject::tr("Cannot get the OpenNI source."));       \
+        return;                                                                        \
+    }
+
+//
+// Internal callbacks, only called by OpenNI internaly
+// The OpenNISensorSource is represented by the *cookie pointer
+//
+
+void XN_CALLBACK_TYPE newUserCallback(xn::UserGenerator& /*generator*/, XnUserID userID, void* cookie)
+{
+    // New user found, start calibration
+    OpenNISensorSource *source;
+    GET_OPENNI_SOURCE(cookie, source);
+    qDebug() << qPrintable(QObject::tr("New user: %1").arg(userID));
+    source->calibrateNewUser(userID);
+}
+
+void XN_CALLBACK_TYPE lostUserCallback(xn::UserGenerator& /*generator*/, XnUserID userID, void* cookie)
+{
+    OpenNISensorSource *source;
+    GET_OPENNI_SOURCE(cookie, source);
+    qDebug() << qPrintable(QObject::tr("Lost user: %1").arg(userID));
+    source->lostUser(userID);
+}
+
+void XN_CALLBACK_TYPE calibrationStartCallback(xn::SkeletonCapability& /*capability*/, XnUserID userID, void* cookie)
+{
+    OpenNISensorSource *source;
+    GET_OPENNI_SOURCE(cookie, source);
+    qDebug() << qPrintable(QObject::tr("Calibration started for user: %1").arg(userID));
+}
+
+void XN_CALLBACK_TYPE calibrationEndCallback(xn::SkeletonCapability& /*capability*/, XnUserID userID, XnCalibrationStatus calibrationStatus, void* cookie)
+{
+    OpenNISensorSource *source;
+    GET_OPENNI_SOURCE(cookie, source);
+    // Check the status
+    if(calibrationStatus == XN_CALIBRATION_STATUS_OK)
+    {
+        // Calibration succeeded
+        qDebug() << qPrintable(QObject::tr("Calibration complete, start tracking user %1").arg(userID));
+        source->startTracking(userID);
+        source->saveCalibration(userID);
+    }
+    else
+    {
+        // Calibration failed
+        qWarning() << qPrintable(QObject::tr("Calibration failed for user: %1").arg(userID));
+        if(calibrationStatus == XN_CALIBRATION_STATUS_MANUAL_ABORT)
+            qWarning() << qPrintable(QObject::tr("Manual abort occured, stop attempting to calibrate !"));
+        else // Restart the calibration process
+            source->startCalibration(userID);
+    }
+}
+
+void XN_CALLBACK_TYPE newDataCallback(xn::ProductionNode& /*node*/, void* cookie)
+{
+    OpenNISensorSource *source;
+    GET_OPENNI_SOURCE(cookie, source);
+    source->notifyNewData();
+}
+
+OpenNISensorSource::OpenNISensorSource(USBDevicePath camPath, USBDevicePath motorPath, const OpenNIUtil::DepthMode& depthMode,
+                                       const QString& calibrationFile, const JointMask joints):
+    _poseExtractor(_userGenerator, _depthGenerator)
+{
+    _poseExtractor.setJoints(joints);
+    _cameraPath = camPath;
+    _motorPath = motorPath;
+    _depthMode = depthMode;
+    _calibrationFile = calibrationFile;
+}
+
+OpenNISensorSource::~OpenNISensorSource()
+{
+    release();
+    USBCommandQueue *usbQueue = _usbQueue.exchange(nullptr);
+    if(usbQueue != nullptr)
+    {
+        usbQueue->setLight(USBController::LightType::LED_BLINK_GREEN);
+        usbQueue->moveToAngle(0);
+        qDebug() << qPrintable(tr("USB commands: %1 replaced by a newer one.").arg(usbQueue->coalescedCommands()));
+        // Wait for the commands to be sent
+        delete usbQueue;
+    }
+    if(_kinectUSB != nullptr)
+        _kinectUSB->deleteLater();
+}
+
+XnStatus OpenNISensorSource::init()
+{
+    qDebug() << qPrintable(tr("Initializing OpenNI ..."));
+
+    XnStatus status = XN_STATUS_OK;
+    _released = false;
+    _profileUser = 0;
+
+    // Init the context
+    status = _context.Init();
+    CHECK_ERROR(status, tr("Context Init", "on error"));
+
+    // List all sensors
+    xn::NodeInfoList devicesList;
+    status = _context.EnumerateProductionTrees(XN_NODE_TYPE_DEVICE, nullptr, devicesList);
+    CHECK_ERROR(status, tr("Search available devices", "on error"));
+
+    // Check if the specified device in constructor exists
+    bool found = false;
+    for(xn::NodeInfoList::Iterator it = devicesList.Begin(); it != devicesList.End(); ++it)
+    {
+        // A sensor was found, add to the list
+        if((*it).GetCreationInfo() == _cameraPath.toString())
+        {
+            xn::NodeInfo nodeInfo = *it;
+            found = true;
+
+            qDebug() << qPrintable(tr("Creating device: %1").arg(_cameraPath.toString()));
+
+            status = _context.CreateProductionTree(nodeInfo, _device);
+            CHECK_ERROR(status, tr("Create device", "on error"));
+
+            // Create the query for the current node
+            xn::Query query;
+            query.AddNeededNode(nodeInfo.GetInstanceName());
+
+            // Create the depth generator
+            status = _context.CreateAnyProductionTree(XN_NODE_TYPE_DEPTH, &query, _depthGenerator);
+            CHECK_ERROR(status, tr("Create depth generator", "on error"));
+
+            // Must be done before the creation of the user generator
+            // Errors are reported by the function
+            status = initDepthMode();
+            if(status != XN_STATUS_OK)
+                return status;
+
+            // Create the user generator
+            status = _context.CreateAnyProductionTree(XN_NODE_TYPE_USER, &query, _userGenerator);
+            CHECK_ERROR(status, tr("Create user generator", "on error"));
+
+            // Register all users callbacks
+            status = _userGenerator.RegisterUserCallbacks(&newUserCallback, &lostUserCallback, this, _userCBHandler);
+            CHECK_ERROR(status, tr("Register to user callbacks", "on error"));
+            status = _userGenerator.GetSkeletonCap().RegisterToCalibrationStart(&calibrationStartCallback, this, _calibrationStartCBHandler);
+            CHECK_ERROR(status, tr("Register to calibration start", "on error"));
+            status = _userGenerator.GetSkeletonCap().RegisterToCalibrationComplete(&calibrationEndCallback, this, _calibrationEndCBHandler);
+            CHECK_ERROR(status, tr("Register to calibration complete", "on error"));
+            // Same event as the one used by WaitOneUpdateAll(), whose timeout can't be changed
+            status = _userGenerator.RegisterToNewDataAvailable(&newDataCallback, this, _newDataCBHandler);
+            CHECK_ERROR(status, tr("Register to new data", "on error"));
+
+            // Check if the user generator support skeleton
+            if(!_userGenerator.IsCapabilitySupported(XN_CAPABILITY_SKELETON))
+            {
+                qCritical() << qPrintable(tr("Supplied user generator doesn't support skeleton capability."));
+                return 20;
+            }
+            // Check if the user generator need a pose for skeleton detection
+            if(_userGenerator.GetSkeletonCap().NeedPoseForCalibration())
+            {
+                qCritical() << qPrintable(tr("Pose calibration required but not supported by this program."));
+                return 30;
+            }
+
+            // Set the skeleton profile
+            _userGenerator.GetSkeletonCap().SetSkeletonProfile(XN_SKEL_PROFILE_ALL);
+            _poseExtractor.updateActiveJoints();
+
+            // Create the usb controller (kept when the source is re-initialized)
+            if(_kinectUSB != nullptr)
+                break;
+            _kinectUSB = new USBController();
+            _kinectUSB->init(_motorPath);
+            // Move the kinect to the angle 0 at startup
+            if(_kinectUSB->initialized())
+            {
+                USBCommandQueue *usbQueue = new USBCommandQueue(_kinectUSB);
+                usbQueue->moveToAngle(0);
+                usbQueue->setLight(USBController::LightType::LED_GREEN);
+                _usbQueue = usbQueue;
+            }
+
+            // Exit the for loop
+            break;
+        }
+    }
+
+    if(!found)
+    {
+        qCritical() << qPrintable(tr("The specified device doesn't exist !"));
+        return 4;
+    }
+
+    return status;
+}
+
+XnStatus OpenNISensorSource::start()
+{
+    const XnStatus status = _context.StartGeneratingAll();
+    CHECK_ERROR(status, tr("Start Generating", "on error"));
+
+    _generating = true;
+    return status;
+}
+
+void OpenNISensorSource::release()
+{
+    if(_released)
+        return;
+
+    _generating = false;
+
+    _depthGenerator.Release();
+    _userGenerator.Release();
+    _device.Release();
+
+    _context.Release();
+
+    _released = true;
+}
+
+bool OpenNISensorSource::waitForNewFrame(const int timeout)
+{
+    // A new depth map alone doesn't change the skeletons, wait for the user generator
+    // OpenNI isn't called under _newDataMutex since the callback takes it from an OpenNI thread
+    std::unique_lock<std::mutex> lock(_newDataMutex);
+    // The events received before are for the frames already updated
+    _newData = false;
+    lock.unlock();
+
+    if(_userGenerator.IsNewDataAvailable())
+        return true;
+
+    lock.lock();
+    const bool available = _newDataCondition.wait_for(lock, std::chrono::milliseconds(timeout),
+                                                      [this]() { return _newData; });
+    _newData = false;
+    return available;
+}
+
+void OpenNISensorSource::notifyNewData()
+{
+    {
+        std::lock_guard<std::mutex> lock(_newDataMutex);
+        _newData = true;
+    }
+    _newDataCondition.notify_one();
+}
+
+bool OpenNISensorSource::update()
+{
+    // Update all generators without blocking
+    _context.WaitNoneUpdateAll();
+    return true;
+}
+
+bool OpenNISensorSource::isUserDataNew() const
+{
+    return _userGenerator.IsDataNew();
+}
+
+uint32_t OpenNISensorSource::frameID() const
+{
+    return _depthGenerator.GetFrameID();
+}
+
+int64_t OpenNISensorSource::timestamp() const
+{
+    return static_cast<int64_t>(_depthGenerator.GetTimestamp());
+}
+
+const XnDepthPixel *OpenNISensorSource::depthMap() const
+{
+    return _depthGenerator.GetDepthMap();
+}
+
+int OpenNISensorSource::depthWidth() const
+{
+    return _depthWidth;
+}
+
+int OpenNISensorSource::depthHeight() const
+{
+    return _depthHeight;
+}
+
+int OpenNISensorSource::trackedUsers(XnUserID *ids, const int maxCount)
+{
+    XnUInt16 usersCount = maxCount;
+    _userGenerator.GetUsers(ids, usersCount);
+
+    // Only keep the users with a skeleton
+    int count = 0;
+    for(XnUInt16 i=0; i < usersCount; ++i)
+    {
+        if(_userGenerator.GetSkeletonCap().IsTracking(ids[i]))
+            ids[count++] = ids[i];
+    }
+    return count;
+}
+
+void OpenNISensorSource::extractUser(const XnUserID userID, OpenNIUtil::User *user)
+{
+    _poseExtractor.extract(userID, user);
+}
+
+void OpenNISensorSource::moveToAngle(const int angle)
+{
+    USBCommandQueue *usbQueue = _usbQueue;
+    if(usbQueue != nullptr)
+        usbQueue->moveToAngle(angle);
+}
+
+void OpenNISensorSource::setLight(const USBController::LightType type)
+{
+    USBCommandQueue *usbQueue = _usbQueue;
+    if(usbQueue != nullptr)
+        usbQueue->setLight(type);
+}
+
+XnStatus OpenNISensorSource::calibrateNewUser(const XnUserID userID)
+{
+    if(!_generating)
+        return 100;
+
+    // Only one user can be the player, the profile is not loaded if another user has it
+    if(!_calibrationFile.isEmpty() && _profileUser == 0 && QFile::exists(_calibrationFile))
+    {
+        const XnStatus status = _userGenerator.GetSkeletonCap().LoadCalibrationDataFromFile(userID, _calibrationFile.toLocal8Bit().constData());
+        if(status == XN_STATUS_OK)
+        {
+            qDebug() << qPrintable(tr("Calibration loaded from %1, start tracking user %2").arg(_calibrationFile).arg(userID));
+            _profileUser = userID;
+            return startTracking(userID);
+        }
+        qWarning() << qPrintable(tr("Can't load the calibration from %1: %2").arg(_calibrationFile, xnGetStatusString(status)));
+    }
+
+    return startCalibration(userID);
+}
+
+XnStatus OpenNISensorSource::startCalibration(const XnUserID userID)
+{
+    if(_generating)
+        return _userGenerator.GetSkeletonCap().RequestCalibration(userID, TRUE);
+    return 100;
+}
+
+XnStatus OpenNISensorSource::startTracking(const XnUserID userID)
+{
+    if(_generating)
+        return _userGenerator.GetSkeletonCap().StartTracking(userID);
+    return 101;
+}
+
+void OpenNISensorSource::saveCalibration(const XnUserID userID)
+{
+    // Never replace an existing profile: the user calibrated now may be someone else than the player
+    if(!_generating || _calibrationFile.isEmpty() || _profileUser != 0 || QFile::exists(_calibrationFile))
+        return;
+
+    const XnStatus status = _userGenerator.GetSkeletonCap().SaveCalibrationDataToFile(userID, _calibrationFile.toLocal8Bit().constData());
+    if(status == XN_STATUS_OK)
+    {
+        qDebug() << qPrintable(tr("Calibration of user %1 saved in %2").arg(userID).arg(_calibrationFile));
+        _profileUser = userID;
+    }
+    else
+        qWarning() << qPrintable(tr("Can't save the calibration in %1: %2").arg(_calibrationFile, xnGetStatusString(status)));
+}
+
+void OpenNISensorSource::lostUser(const XnUserID userID)
+{
+    // The profile can be given to the next new user
+    if(userID == _profileUser)
+        _profileUser = 0;
+}
+
+// Private
+XnStatus OpenNISensorSource::initDepthMode()
+{
+    XnStatus status = XN_STATUS_OK;
+
+    if(_depthMode.width > 0 && _depthMode.height > 0)
+    {
+        XnUInt32 count = _depthGenerator.GetSupportedMapOutputModesCount();
+        std::vector<XnMapOutputMode> modes(count);
+        status = _depthGenerator.GetSupportedMapOutputModes(modes.data(), count);
+        CHECK_ERROR(status, tr("Get the supported depth modes", "on error"));
+
+        // Keep the highest frame rate of the requested resolution
+        int selected = -1;
+        for(XnUInt32 i=0; i < count; ++i)
+        {
+            if(static_cast<int>(modes[i].nXRes) == _depthMode.width && static_cast<int>(modes[i].nYRes) == _depthMode.height
+               && (_depthMode.fps <= 0 || static_cast<int>(modes[i].nFPS) == _depthMode.fps)
+               && (selected == -1 || modes[i].nFPS > modes[selected].nFPS))
+                selected = i;
+        }
+
+        if(selected == -1 || modes[selected].nXRes * modes[selected].nYRes > MAX_DEPTH_MAP_LENGTH)
+        {
+            qWarning() << qPrintable(tr("The depth mode %1x%2 is not supported by the sensor, the default one is used. Supported modes:")
+                                     .arg(_depthMode.width).arg(_depthMode.height));
+            for(XnUInt32 i=0; i < count; ++i)
+                qWarning() << qPrintable(tr("- %1x%2 at %3 FPS").arg(modes[i].nXRes).arg(modes[i].nYRes).arg(modes[i].nFPS));
+        }
+        else
+        {
+            status = _depthGenerator.SetMapOutputMode(modes[selected]);
+            CHECK_ERROR(status, tr("Set the depth output mode", "on error"));
+        }
+    }
+
+    XnMapOutputMode mode;
+    status = _depthGenerator.GetMapOutputMode(mode);
+    CHECK_ERROR(status, tr("Get the depth output mode", "on error"));
+
+    if(mode.nXRes * mode.nYRes > MAX_DEPTH_MAP_LENGTH)
+    {
+        qCritical() << qPrintable(tr("The depth maps of the sensor are too large (%1x%2) !").arg(mode.nXRes).arg(mode.nYRes));
+        return 21;
+    }
+
+    _depthWidth = mode.nXRes;
+    _depthHeight = mode.nYRes;
+    qDebug() << qPrintable(tr("Depth mode: %1x%2 at %3 FPS.").arg(mode.nXRes).arg(mode.nYRes).arg(mode.nFPS));
+
+    return status;
+}
@@ -0,0 +1,125 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPENNISENSORSOURCE_H
+#define OPENNISENSORSOURCE_H
+
+#include <ni/XnOpenNI.h>
+#include <ni/XnCodecIDs.h>
+#include <ni/XnCppWrapper.h>
+
+#include <QCoreApplication>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include "sensorsource.h"
+#include "poseextractor.h"
+#include "usbcommandqueue.h"
+
+// Frames generated by a real sensor through an OpenNI context
+class OpenNISensorSource: public SensorSource
+{
+        Q_DECLARE_TR_FUNCTIONS(OpenNISensorSource)
+
+    public:
+        // The depth mode is applied if the sensor supports it (see OpenNIUtil::DepthMode)
+        // The skeleton calibration of the player is saved in the calibration file if it doesn't exist yet,
+        // and loaded for a new user so the player is tracked immediately (disabled if the path is empty).
+        // The profile is only given to one user at a time, the others are calibrated normally
+        // Only the joints of the mask are extracted from the skeletons
+        OpenNISensorSource(USBDevicePath camPath, USBDevicePath motorPath, const OpenNIUtil::DepthMode& depthMode,
+                           const QString& calibrationFile, const JointMask joints = DEFAULT_JOINT_MASK);
+        ~OpenNISensorSource();
+
+        XnStatus init();
+        XnStatus start();
+        void release();
+
+        bool waitForNewFrame(const int timeout);
+        bool update();
+        bool isUserDataNew() const;
+
+        uint32_t frameID() const;
+        int64_t timestamp() const;
+        const XnDepthPixel *depthMap() const;
+        int depthWidth() const;
+        int depthHeight() const;
+
+        int trackedUsers(XnUserID *ids, const int maxCount);
+        void extractUser(const XnUserID userID, OpenNIUtil::User *user);
+
+        void moveToAngle(const int angle);
+        void setLight(const USBController::LightType type);
+
+        // Don't call these functions directly, they are usually called from the Callbacks methods
+        // Load the saved calibration, or start the calibration if it fails
+        XnStatus calibrateNewUser(const XnUserID userID);
+        XnStatus startCalibration(const XnUserID userID);
+        XnStatus startTracking(const XnUserID userID);
+        void saveCalibration(const XnUserID userID);
+        void lostUser(const XnUserID userID);
+        // Wake up waitForNewFrame(), called from the OpenNI threads
+        void notifyNewData();
+
+    private:
+        // Select the output mode of the depth generator and read the resulting size
+        XnStatus initDepthMode();
+
+        bool _released = false;
+        std::atomic<bool> _generating{false};
+
+        USBDevicePath _cameraPath;
+        USBDevicePath _motorPath;
+
+        OpenNIUtil::DepthMode _depthMode;
+        QString _calibrationFile;
+        // User tracked with the calibration profile (0 if none)
+        XnUserID _profileUser = 0;
+        int _depthWidth = DEFAULT_DEPTH_MAP_WIDTH;
+        int _depthHeight = DEFAULT_DEPTH_MAP_HEIGHT;
+
+        USBController *_kinectUSB = nullptr;
+        // Commands are sent in their own thread, only created if the USB controller is initialized
+        std::atomic<USBCommandQueue*> _usbQueue{nullptr};
+
+        xn::Context _context;
+
+        xn::ProductionNode _device;
+        xn::NodeInfo _nodeInfo = xn::NodeInfo(nullptr);
+
+        // Generators
+        xn::DepthGenerator _depthGenerator;
+        xn::UserGenerator _userGenerator;
+
+        // Callbacks handler
+        XnCallbackHandle _userCBHandler;
+        XnCallbackHandle _calibrationStartCBHandler;
+        XnCallbackHandle _calibrationEndCBHandler;
+        XnCallbackHandle _newDataCBHandler;
+
+        // Signaled by the user generator when it has new data
+        std::mutex _newDataMutex;
+        std::condition_variable _newDataCondition;
+        bool _newData = false;
+
+        // Must be declared after the generators
+        PoseExtractor _poseExtractor;
+};
+
+#endif // OPENNISENSORSOURCE_H
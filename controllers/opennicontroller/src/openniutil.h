@@ -27,8 +27,14 @@
 
 #include "controllercommon.h"
 
-#define DEPTH_MAP_LENGTH (640*480)
+// Size of the depth maps when the sensor mode is not changed (VGA)
+#define DEFAULT_DEPTH_MAP_WIDTH 640
+#define DEFAULT_DEPTH_MAP_HEIGHT 480
+// Largest depth map supported, used to preallocate the buffers
+#define MAX_DEPTH_MAP_LENGTH (640*480)
 #define MIN_COMPUTED_WALKSPEED 70
+// Maximum number of users tracked at the same time
+#define MAX_TRACKED_USERS 6
 
 // Contains some structures for OpenNI data
 namespace OpenNIUtil
@@ -57,9 +63,9 @@ namespace OpenNIUtil
         XnUserID id;
         bool isTracking = false;
 
-        // The timestamp when this object was generated
-        // Represent the time in milliseconds since the epoch time
-        int64_t timestamp;
+        // The timestamp of the sensor frame used to generate this object
+        // Represent the time in microseconds given by the sensor clock
+        int64_t timestamp = 0;
 
         Joint torsoJoint;
 
@@ -73,18 +79,48 @@ namespace OpenNIUtil
 
         int rotation = -1;
         int walkSpeed = -1;
+        // Rates of change, in degrees/s and cm/s² (see MotionHistory)
+        float rotationRate = 0.0f;
+        float walkSpeedRate = 0.0f;
 
         // Summary the number of frames since the last move
         int numberOfFramesWithoutMove = 0;
     };
 
+    // Output mode of the depth generator
+    // A null size keeps the mode of the sensor, a null FPS selects the highest one
+    struct DepthMode
+    {
+        int width = 0;
+        int height = 0;
+        int fps = 0;
+    };
+
     // Contains all data from the OpenNI loop
+    // The depth map is not stored here, see DepthFramePool
     struct CameraInformations
     {
+        // Sequence number of the frame (starts at 1)
+        uint32_t frameNumber = 0;
+
+        // Frame ID and timestamp (in µs) given by the sensor
+        uint32_t sensorFrameID = 0;
+        int64_t sensorTimestamp = 0;
+        // Time (in µs, from a monotonic clock) when the frame was received
+        int64_t hostTimestamp = 0;
+        // Number of sensor frames missed since the start (detected with the frame IDs)
+        uint32_t droppedSensorFrames = 0;
+
+        // The selected user
         User user;
 
-        // The depth map (values are in mm)
-        XnDepthPixel *depthData = nullptr;
+        // IDs of all tracked users (including the selected one)
+        XnUserID trackedUsers[MAX_TRACKED_USERS] = {};
+        int trackedUsersCount = 0;
+
+        // Size of the depth map, the projective positions of the joints are relative to it
+        uint32_t depthWidth = DEFAULT_DEPTH_MAP_WIDTH;
+        uint32_t depthHeight = DEFAULT_DEPTH_MAP_HEIGHT;
 
         bool invalid = false;
 
@@ -97,6 +133,35 @@ namespace OpenNIUtil
         return camInfo;
     }
 
+    // Return the joint of the user corresponding to the type
+    // Return nullptr if this joint is not stored in the User structure
+    inline Joint* jointOfUser(User *user, const XnSkeletonJoint type)
+    {
+        switch(type)
+        {
+            case XN_SKEL_TORSO:
+                return &user->torsoJoint;
+            case XN_SKEL_LEFT_HIP:
+                return &user->leftPart.hip;
+            case XN_SKEL_LEFT_KNEE:
+                return &user->leftPart.knee;
+            case XN_SKEL_LEFT_FOOT:
+                return &user->leftPart.foot;
+            case XN_SKEL_LEFT_SHOULDER:
+                return &user->leftPart.shoulder;
+            case XN_SKEL_RIGHT_HIP:
+                return &user->rightPart.hip;
+            case XN_SKEL_RIGHT_KNEE:
+                return &user->rightPart.knee;
+            case XN_SKEL_RIGHT_FOOT:
+                return &user->rightPart.foot;
+            case XN_SKEL_RIGHT_SHOULDER:
+                return &user->rightPart.shoulder;
+            default:
+                return nullptr;
+        }
+    }
+
     inline bool isJointAcceptable(const Joint joint)
     {
         return joint.isActive && joint.info.fConfidence == 1.0f;
@@ -112,6 +177,17 @@ namespace OpenNIUtil
         return angle;
     }
 
+    // Return the difference a - b of two angles (in degrees), in range [-180;180[
+    inline float angleDifference(const float a, const float b)
+    {
+        float diff = std::fmod(a - b, 360.0f);
+        if(diff >= 180.0f)
+            diff -= 360.0f;
+        else if(diff < -180.0f)
+            diff += 360.0f;
+        return diff;
+    }
+
     // Compute the mean angle using the circular average method
     // See <http://en.wikipedia.org/wiki/Mean_of_circular_quantities> for more informations
     inline float meanAngle(float *angles, const int size)
@@ -135,8 +211,9 @@ namespace OpenNIUtil
         return allFalse ? -1.0f : reduceAngle(std::atan2(y / size, x / size) * RAD2DEG);
     }
 
-    // The previous rotation parameter is used to avoid big differences between two rotation
-    inline float rotationFrom2Joints(const int frequency, const Joint rightJoint, const Joint leftJoint, float previousRotation)
+    // Return the raw rotation (in degrees), or -1 if a joint is not acceptable
+    // The rotation is smoothed later (see ScalarFilter)
+    inline float rotationFrom2Joints(const Joint rightJoint, const Joint leftJoint)
     {
         if(isJointAcceptable(rightJoint) && isJointAcceptable(leftJoint))
         {
@@ -183,72 +260,32 @@ namespace OpenNIUtil
                     rotation =  360.0f - angle;
             }
 
-            //
-            // Smooth the rotation
-            //
-
-            if(previousRotation != -1.0f)
-            {
-                // If the difference of rotation is higher than 180°, we consider
-                // that we move from the 360° to the 0° side
-                // In this case, add 360° to the lower value
-                if(std::abs(rotation - previousRotation) > 180.0f)
-                {
-                    if(rotation < previousRotation)
-                        rotation += 360.0f;
-                    else
-                        previousRotation += 360.0f;
-                }
-
-                const float margin = 60.0f / (float)frequency;
-
-                const float diffRotation = rotation - previousRotation;
-                if(std::abs(diffRotation) > margin)
-                {
-                    // If new rotation is higher
-                    if(diffRotation > 0.0f)
-                    {
-                        rotation = previousRotation + margin;
-                    }
-                    // If new rotation is lower
-                    else
-                    {
-                        rotation = previousRotation - margin;
-                    }
-                }
-
-                if(rotation >= 360.0f)
-                    rotation -= 360.0f;
-            }
-
             return rotation;
         }
 
         return -1.0f;
     }
 
-    inline void rotationForUser(const int frequency, const int previousRotation, User* user)
+    // Return the raw rotation of the user (in degrees), or -1 if it can't be computed
+    inline float rotationForUser(const User& user)
     {
         float rotations[4] = {-1.0f, -1.0f, -1.0f, -1.0f};
 
         // right hip / left hip
-        rotations[0] = rotationFrom2Joints(frequency, user->rightPart.hip, user->leftPart.hip,
-                                            previousRotation);
+        rotations[0] = rotationFrom2Joints(user.rightPart.hip, user.leftPart.hip);
         // right hip / torso
-        rotations[1] = rotationFrom2Joints(frequency, user->rightPart.hip, user->torsoJoint,
-                                            previousRotation);
+        rotations[1] = rotationFrom2Joints(user.rightPart.hip, user.torsoJoint);
         // torso / left hip
-        rotations[2] = rotationFrom2Joints(frequency, user->torsoJoint, user->leftPart.hip,
-                                            previousRotation);
+        rotations[2] = rotationFrom2Joints(user.torsoJoint, user.leftPart.hip);
         // right shoulder / left shoulder
-        rotations[3] = rotationFrom2Joints(frequency, user->rightPart.shoulder, user->leftPart.shoulder,
-                                            previousRotation);
+        rotations[3] = rotationFrom2Joints(user.rightPart.shoulder, user.leftPart.shoulder);
 
         // Make an average
-        user->rotation = static_cast<int>(meanAngle(rotations, 4));
+        return meanAngle(rotations, 4);
     }
 
-    inline int walkSpeedForUser(const int frequency, const User& user, const int64_t& previousTimestamp, const int& previousSpeed)
+    // Return the raw walk speed of the user (in cm/s), or -1 if it can't be computed
+    inline float walkSpeedForUser(const User& user, const int64_t& previousTimestamp)
     {
         // Compute the x and z diff for the right and left foot
         float rdx = 0;
@@ -273,7 +310,7 @@ namespace OpenNIUtil
         }
 
         if(cantCompute)
-            return -1;
+            return -1.0f;
 
         const float rightDiff = std::sqrt(std::pow(rdx, 2.0) + std::pow(rdz, 2.0));
         const float leftDiff = std::sqrt(std::pow(ldx, 2.0) + std::pow(ldz, 2.0));
@@ -281,27 +318,13 @@ namespace OpenNIUtil
         // Compute the average of diff (in mm)
         const float diff = (rightDiff + leftDiff) / 2.0;
 
-        // Compute diff of timestamp
+        // Compute diff of timestamp (in µs)
         const int64_t diffTime = user.timestamp - previousTimestamp;
+        if(diffTime <= 0)
+            return -1.0f;
 
         // Now compute the speed in cm/s
-        int speed = static_cast<int>((diff * 0.1) / ((double)(diffTime) * 0.001));
-
-        // Smooth the value depending on the last one
-        if(previousSpeed != -1)
-        {
-            const int margin = 100.0f / (float)frequency;
-
-            if(std::abs(speed - previousSpeed) > margin)
-            {
-                if(speed < previousSpeed)
-                    speed = previousSpeed - margin;
-                else
-                    speed = previousSpeed + margin;
-            }
-        }
-
-        return speed;
+        return static_cast<float>((diff * 0.1) / ((double)(diffTime) * 0.000001));
     }
 }
 
@@ -17,109 +17,359 @@
  */
 
 #include "openniworker.h"
+#include "opennisensorsource.h"
+#include "replaysensorsource.h"
 
 #include <QCoreApplication>
-#include <QProcess>
 #include <QStringList>
+#include <QRegularExpression>
+#include <QStandardPaths>
+#include <QDir>
 
-OpenNIWorker::OpenNIWorker(int frequency, QObject *parent) : QObject(parent)
+#include <algorithm>
+
+const QString optionSourceStr = "source";
+const QString optionReplayFileStr = "replayFile";
+const QString optionReplaySpeedStr = "replaySpeed";
+const QString optionReplayLoopStr = "replayLoop";
+const QString optionAutoTiltStr = "autoTilt";
+const QString optionDepthModeStr = "depthMode";
+const QString optionJointsStr = "joints";
+const QString optionStallTimeoutStr = "stallTimeout";
+const QString optionPlayerStr = "player";
+const QString optionProcessingPolicyStr = "processingPolicy";
+const QString optionPublicationPolicyStr = "publicationPolicy";
+const QString optionFilterStr = "filter";
+const QString optionPredictionHorizonStr = "predictionHorizon";
+const QString optionRotationStr = "rotation";
+const QString optionSpeedStr = "speed";
+const QString optionMinCutoffStr = "MinCutoff";
+const QString optionBetaStr = "Beta";
+const QString optionResponseTimeStr = "ResponseTime";
+const QString optionProcessNoiseStr = "ProcessNoise";
+const QString optionMeasurementNoiseStr = "MeasurementNoise";
+
+const QString sourceReplayStr = "replay";
+
+const QString policyKeepAllStr = "keepAll";
+const QString policyDropOldestStr = "dropOldest";
+
+const QString filterNoneStr = "none";
+const QString filterOneEuroStr = "oneEuro";
+const QString filterCriticallyDampedStr = "criticallyDamped";
+const QString filterKalmanStr = "kalman";
+
+static JointMask jointMask(const QVariantMap& options)
+{
+    static const struct
+    {
+        const char *name;
+        XnSkeletonJoint joint;
+    } jointNames[] = {
+        {"torso", XN_SKEL_TORSO},
+        {"leftHip", XN_SKEL_LEFT_HIP}, {"rightHip", XN_SKEL_RIGHT_HIP},
+        {"leftKnee", XN_SKEL_LEFT_KNEE}, {"rightKnee", XN_SKEL_RIGHT_KNEE},
+        {"leftFoot", XN_SKEL_LEFT_FOOT}, {"rightFoot", XN_SKEL_RIGHT_FOOT},
+        {"leftShoulder", XN_SKEL_LEFT_SHOULDER}, {"rightShoulder", XN_SKEL_RIGHT_SHOULDER}
+    };
+
+    const QString value = options.value(optionJointsStr).toString();
+    if(value.isEmpty())
+        return DEFAULT_JOINT_MASK;
+
+    JointMask mask = 0;
+    for(const QString& name : value.split(',', QString::SkipEmptyParts))
+    {
+        bool found = false;
+        for(const auto& jointName : jointNames)
+        {
+            if(name.trimmed() == QLatin1String(jointName.name))
+            {
+                mask |= JOINT_BIT(jointName.joint);
+                found = true;
+                break;
+            }
+        }
+        if(!found)
+            qWarning() << qPrintable(QObject::tr("Invalid joint for the option %1: %2").arg(optionJointsStr, name));
+    }
+
+    if(mask == 0)
+    {
+        qWarning() << qPrintable(QObject::tr("No valid joint in the option %1, all joints are used.").arg(optionJointsStr));
+        return DEFAULT_JOINT_MASK;
+    }
+    return mask;
+}
+
+static DropPolicy dropPolicy(const QVariantMap& options, const QString& key, const DropPolicy defaultPolicy)
 {
-    _frequency = frequency;
+    const QString value = options.value(key).toString();
+    if(value == policyKeepAllStr)
+        return DropPolicy::KeepAll;
+    else if(value == policyDropOldestStr)
+        return DropPolicy::DropOldest;
+    else if(!value.isEmpty())
+        qWarning() << qPrintable(QObject::tr("Invalid value for the option %1: %2").arg(key, value));
+    return defaultPolicy;
+}
+
+// The parameters of the quantity are prefixed by its name (e.g. "rotationBeta")
+static FilterSettings filterSettings(const QVariantMap& options, const QString& prefix, FilterSettings settings)
+{
+    const QString type = options.value(optionFilterStr).toString();
+    if(type == filterNoneStr)
+        settings.type = FilterType::None;
+    else if(type == filterOneEuroStr)
+        settings.type = FilterType::OneEuro;
+    else if(type == filterCriticallyDampedStr)
+        settings.type = FilterType::CriticallyDamped;
+    else if(type == filterKalmanStr)
+        settings.type = FilterType::Kalman;
+    else if(!type.isEmpty())
+        qWarning() << qPrintable(QObject::tr("Invalid value for the option %1: %2").arg(optionFilterStr, type));
+
+    settings.minCutoff = options.value(prefix + optionMinCutoffStr, settings.minCutoff).toFloat();
+    settings.beta = options.value(prefix + optionBetaStr, settings.beta).toFloat();
+    settings.responseTime = options.value(prefix + optionResponseTimeStr, settings.responseTime).toFloat();
+    settings.processNoise = options.value(prefix + optionProcessNoiseStr, settings.processNoise).toFloat();
+    settings.measurementNoise = options.value(prefix + optionMeasurementNoiseStr, settings.measurementNoise).toFloat();
+
+    if(settings.minCutoff <= 0.0f || settings.responseTime <= 0.0f || settings.measurementNoise <= 0.0f)
+    {
+        qWarning() << qPrintable(QObject::tr("Invalid %1 filter parameters, the defaults are used.").arg(prefix));
+        const FilterType type = settings.type;
+        settings = prefix == optionRotationStr ? defaultRotationFilter() : defaultSpeedFilter();
+        settings.type = type;
+    }
+    return settings;
+}
+
+OpenNIWorker::OpenNIWorker(const QVariantMap& options, QObject *parent) : QObject(parent),
+    _stats(QStringList() << tr("Wait for frame") << tr("Skeleton extraction") << tr("Rotation and speed")
+                         << tr("Publication") << tr("Pipeline transit") << tr("Data age at read")
+                         << tr("Render") << tr("Display") << tr("Stall recovery"))
+{
+    _options = options;
+    _autoTiltEnabled = _options.value(optionAutoTiltStr, false).toBool();
+    _rotationFilter = filterSettings(_options, optionRotationStr, defaultRotationFilter());
+    _speedFilter = filterSettings(_options, optionSpeedStr, defaultSpeedFilter());
+    const int horizon = _options.value(optionPredictionHorizonStr, DEFAULT_PREDICTION_HORIZON).toInt();
+    _predictionHorizon = horizon < 0 ? -1 : static_cast<int64_t>(horizon) * 1000;
+    _jointMask = jointMask(_options);
+
+    const QString depthMode = _options.value(optionDepthModeStr).toString();
+    if(!depthMode.isEmpty())
+    {
+        const QRegularExpressionMatch match = QRegularExpression("^(\\d+)x(\\d+)(?:@(\\d+))?$").match(depthMode);
+        if(match.hasMatch())
+        {
+            _depthMode.width = match.captured(1).toInt();
+            _depthMode.height = match.captured(2).toInt();
+            _depthMode.fps = match.captured(3).toInt();
+        }
+        else
+            qWarning() << qPrintable(tr("Invalid depth mode: %1, the mode of the sensor is used.").arg(depthMode));
+    }
+
+    if(_options.value(optionSourceStr).toString() != sourceReplayStr)
+    {
+        _hotplugMonitor = new USBHotplugMonitor();
+
+        // Stop immediately, the frame loop would wait forever
+        // Runs in the thread of the monitor, so it only requests the stop
+        connect(_hotplugMonitor, &USBHotplugMonitor::kinectDeviceRemoved, this, [this](USBDevicePath path) {
+            if(path.product == KINECT_CAMERA_PRODUCT_ID && path.bus == _cameraBus && path.device == _cameraDevice)
+            {
+                qWarning() << qPrintable(tr("The sensor was unplugged (%1) !").arg(path.toString()));
+                stopLoop();
+            }
+        }, Qt::DirectConnection);
+
+        // Processed in the worker thread, once the frame loop is stopped
+        _relaunchTimer = new QTimer(this);
+        _relaunchTimer->setSingleShot(true);
+        _relaunchTimer->setInterval(SENSOR_PLUG_DELAY);
+        connect(_relaunchTimer, &QTimer::timeout, this, &OpenNIWorker::launch);
+        connect(_hotplugMonitor, &USBHotplugMonitor::kinectDeviceAdded, _relaunchTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
+    }
 }
 
 OpenNIWorker::~OpenNIWorker()
 {
+    // The recorder holds frames of the app
+    _recorder.stop();
+
     if(_app != nullptr)
     {
-        // Wait for the frame loop stop
-        while(!_app->isStopped())
-        {}
+        // Deleted in the worker thread once launch() returned, so the frame loop is stopped
+        _loopApp = nullptr;
+        _app->stop();
         delete _app;
         _app = nullptr;
     }
+
+    if(_hotplugMonitor != nullptr)
+        _hotplugMonitor->deleteLater();
 }
 
 void OpenNIWorker::launch()
 {
-    // List all available devices using the "lsusb" command
-    QProcess lsusbProcess;
-    lsusbProcess.start(QStringLiteral("lsusb"));
-    lsusbProcess.waitForFinished(-1);
-    QString lsusb = QString(lsusbProcess.readAllStandardOutput());
-
-    /*
-     * Sample output is:
-     *
-     * Bus 001 Device 011: ID 045e:02ae Microsoft Corp. Xbox NUI Camera
-     * Bus 001 Device 007: ID 045e:02b0 Microsoft Corp. Xbox NUI Motor
-     */
-
-    QStringList sensorsLineList = lsusb.split("\n", QString::SkipEmptyParts);
-    QList<USBDevicePath> motorsList;
-    QList<USBDevicePath> camerasList;
-    for(QString line : sensorsLineList)
+    if(_stopRequested)
+        return;
+
+    SensorSource *source = nullptr;
+    // A replayed session never stalls (its pauses are part of the recording)
+    int stallTimeout = 0;
+    if(_options.value(optionSourceStr).toString() == sourceReplayStr)
     {
-        if(line.contains(QStringLiteral("045e")) && line.contains(QStringLiteral("Microsoft Corp. Xbox NUI")))
-        {
-            // Cameras
-            if(line.contains(QStringLiteral("ID 045e:02ae")))
-            {
-                camerasList.append(USBDevicePath({KINECT_VENDOR_ID, KINECT_CAMERA_PRODUCT_ID,
-                                                  line.mid(4, 3).toInt(), line.mid(15, 3).toInt()}));
-            }
-            // Motors
-            else if(line.contains(QStringLiteral("ID 045e:02b0")))
-            {
-                motorsList.append(USBDevicePath({KINECT_VENDOR_ID, KINECT_MOTOR_PRODUCT_ID,
-                                                 line.mid(4, 3).toInt(), line.mid(15, 3).toInt()}));
-            }
-        }
+        source = new ReplaySensorSource(_options.value(optionReplayFileStr).toString(),
+                                        _options.value(optionReplaySpeedStr, 1.0).toDouble(),
+                                        _options.value(optionReplayLoopStr, false).toBool());
+    }
+    else
+    {
+        source = createOpenNISource();
+        stallTimeout = _options.value(optionStallTimeoutStr, DEFAULT_STALL_TIMEOUT).toInt();
+    }
+
+    if(source == nullptr)
+        return;
+
+    if(_app == nullptr)
+    {
+        _app = new OpenNIApplication(source, &_stats);
+        connect(_app, &OpenNIApplication::frameReady, this, &OpenNIWorker::frameReady, Qt::DirectConnection);
+        connect(_app, &OpenNIApplication::frameReady, this, &OpenNIWorker::processFrame, Qt::DirectConnection);
+        _loopApp = _app;
     }
+    else // The sensor was plugged again, the previous loop is stopped
+        _app->reset(source);
+
+    // A stop requested before the app was available (or cleared by reset()) is passed on,
+    // then start() returns immediately
+    if(_stopRequested)
+        _app->requestStop();
+
+    _app->selectUser(_selectedUser);
+    _app->setStallTimeout(stallTimeout);
+    // Every frame is needed to compute the speed, but only the newest one is worth publishing
+    _app->setDropPolicies(dropPolicy(_options, optionProcessingPolicyStr, DropPolicy::KeepAll),
+                          dropPolicy(_options, optionPublicationPolicyStr, DropPolicy::DropOldest));
+    _app->setFilters(_rotationFilter, _speedFilter);
+    _app->setPredictionHorizon(std::max<int64_t>(_predictionHorizon, 0));
+
+    // The frame loop isn't running on failure, so the source is released here
+    if(_app->init() != XN_STATUS_OK || _app->start() != XN_STATUS_OK)
+        _app->stop();
+}
+
+SensorSource *OpenNIWorker::createOpenNISource()
+{
+    const QList<KinectSensor> sensors = USBDevices::kinectSensors();
 
     // Debug infos
-    qDebug() << qPrintable(tr("Sensors (camera):"));
-    for(int i=0; i < camerasList.size(); ++i)
-        qDebug() << qPrintable(QString("- %1").arg(camerasList[i].toString()));
-    qDebug() << qPrintable(tr("Sensors (motor):"));
-    for(int i=0; i < motorsList.size(); ++i)
-        qDebug() << qPrintable(QString("- %1").arg(motorsList[i].toString()));
-
-    // Check the number of sensors found
-    if(motorsList.isEmpty() || camerasList.isEmpty())
+    qDebug() << qPrintable(tr("Sensors:"));
+    for(const KinectSensor& sensor : sensors)
+        qDebug() << qPrintable(tr("- camera %1, motor %2").arg(sensor.camera.toString(), sensor.motor.toString()));
+
+    if(sensors.isEmpty())
     {
-        qCritical() << qPrintable(tr("There is not enough connected sensors !"));
-        return;
+        if(_hotplugMonitor != nullptr && _hotplugMonitor->isValid())
+            qWarning() << qPrintable(tr("There is no connected sensor, waiting for one to be plugged ..."));
+        else
+            qCritical() << qPrintable(tr("There is not enough connected sensors !"));
+        return nullptr;
     }
 
-    // Get the first sensor in lists
-    _app = new OpenNIApplication(_frequency, camerasList[0], motorsList[0]);
+    _cameraBus = sensors[0].camera.bus;
+    _cameraDevice = sensors[0].camera.device;
+
+    // Use the first sensor
+    return new OpenNISensorSource(sensors[0].camera, sensors[0].motor, _depthMode, calibrationFile(), _jointMask);
+}
+
+QString OpenNIWorker::calibrationFile() const
+{
+    const QString player = _options.value(optionPlayerStr).toString();
+    if(player.isEmpty())
+        return QString();
+
+    // One profile per player
+    const QDir dir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/calibration");
+    if(!dir.mkpath("."))
+    {
+        qWarning() << qPrintable(tr("Can't create the calibration directory %1 !").arg(dir.path()));
+        return QString();
+    }
 
-    if(_app->init() != XN_STATUS_OK)
-        requestStop();
-    if(_app->start() != XN_STATUS_OK)
-        requestStop();
+    QString fileName = player;
+    fileName.replace(QRegularExpression("[^A-Za-z0-9_-]"), "_");
+    return dir.filePath(fileName + ".xncal");
 }
 
 void OpenNIWorker::setMotorAngle(const int angle)
 {
+    _autoTilt.setAngle(angle);
     if(_app != nullptr && _app->isInitialized())
         _app->moveToAngle(angle);
 }
 
+void OpenNIWorker::setAutoTilt(const bool enabled)
+{
+    _autoTiltEnabled = enabled;
+}
+
+bool OpenNIWorker::isAutoTiltEnabled() const
+{
+    return _autoTiltEnabled;
+}
+
 void OpenNIWorker::requestStop()
 {
+    _stopRequested = true;
+    stopLoop();
+}
+
+void OpenNIWorker::stopLoop()
+{
+    OpenNIApplication *app = _loopApp;
+    if(app != nullptr)
+        app->requestStop();
+}
+
+void OpenNIWorker::selectUser(const int userID)
+{
+    _selectedUser = userID;
     if(_app != nullptr)
-        _app->requestStop();
+        _app->selectUser(userID);
+}
+
+QList<int> OpenNIWorker::userIDs()
+{
+    QList<int> list;
+    const OpenNIUtil::CameraInformations info = lastCamInfo();
+    for(int i=0; i < info.trackedUsersCount; ++i)
+        list.append(info.trackedUsers[i]);
+    return list;
 }
 
 int OpenNIWorker::orientationValue()
 {
-    return camInfo().user.rotation;
+    const OpenNIUtil::CameraInformations info = camInfo();
+    if(info.invalid || _predictionHorizon < 0)
+        return info.user.rotation;
+
+    return static_cast<int>(predictRotation(info.user.rotation, info.user.rotationRate, predictionTime(info)));
 }
 
 int OpenNIWorker::walkSpeedValue()
 {
-    return camInfo().user.walkSpeed;
+    const OpenNIUtil::CameraInformations info = camInfo();
+    if(info.invalid || _predictionHorizon < 0)
+        return info.user.walkSpeed;
+
+    return static_cast<int>(predictSpeed(info.user.walkSpeed, info.user.walkSpeedRate, predictionTime(info)));
 }
 
 int OpenNIWorker::specialCode()
@@ -133,6 +383,10 @@ OpenNIUtil::CameraInformations OpenNIWorker::camInfo()
         return OpenNIUtil::createInvalidCamInfo();
 
     OpenNIUtil::CameraInformations camInfo = _app->lastCamInfo();
+    // The sensor is stalled
+    if(camInfo.invalid)
+        return camInfo;
+    _readAge = LatencyTimer::now() - camInfo.hostTimestamp;
 
     if(camInfo.user.numberOfFramesWithoutMove > 10)
         _specialCode = 2;
@@ -141,3 +395,82 @@ OpenNIUtil::CameraInformations OpenNIWorker::camInfo()
 
     return camInfo;
 }
+
+void OpenNIWorker::dataSent()
+{
+    if(_readAge < 0)
+        return;
+    _stats.addSample(PipelineStage::DataAge, _readAge);
+    _readAge = -1;
+}
+
+OpenNIUtil::CameraInformations OpenNIWorker::lastCamInfo()
+{
+    if(_app == nullptr || !_app->isStarted())
+        return OpenNIUtil::createInvalidCamInfo();
+    return _app->lastCamInfo();
+}
+
+PipelineStats& OpenNIWorker::stats()
+{
+    return _stats;
+}
+
+int OpenNIWorker::stalls() const
+{
+    return _app != nullptr ? _app->stalls() : 0;
+}
+
+bool OpenNIWorker::startRecording(const QString& path, const bool withDepth)
+{
+    if(_app == nullptr || !_app->isInitialized())
+        return _recorder.start(path, withDepth, DEFAULT_DEPTH_MAP_WIDTH, DEFAULT_DEPTH_MAP_HEIGHT);
+    return _recorder.start(path, withDepth, _app->depthWidth(), _app->depthHeight());
+}
+
+void OpenNIWorker::stopRecording()
+{
+    _recorder.stop();
+}
+
+bool OpenNIWorker::isRecording() const
+{
+    return _recorder.isRecording();
+}
+
+DepthFrame OpenNIWorker::depthFrame()
+{
+    if(_app == nullptr || !_app->isStarted())
+        return DepthFrame();
+    return _app->lastDepthFrame();
+}
+
+// Private
+int64_t OpenNIWorker::predictionTime(const OpenNIUtil::CameraInformations& info) const
+{
+    // Age of the frame, plus the time before the values are used
+    return LatencyTimer::now() - info.hostTimestamp + _predictionHorizon;
+}
+
+void OpenNIWorker::processFrame()
+{
+    const OpenNIUtil::CameraInformations camInfo = _app->lastCamInfo();
+    // Published during a stall of the sensor
+    if(camInfo.invalid)
+        return;
+
+    if(_recorder.isRecording())
+        _recorder.record(camInfo, _app->lastDepthFrame());
+
+    const bool autoTilt = _autoTiltEnabled;
+    if(autoTilt && !_autoTiltWasEnabled)
+        _autoTilt.reset();
+    _autoTiltWasEnabled = autoTilt;
+
+    // The command is sent by the USB thread
+    if(autoTilt && _autoTilt.update(camInfo))
+    {
+        _app->moveToAngle(_autoTilt.angle());
+        emit motorAngleChanged(_autoTilt.angle());
+    }
+}
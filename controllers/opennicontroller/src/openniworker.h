@@ -20,37 +20,167 @@
 #define OPENNIPROCESSWORKER
 
 #include <QObject>
+#include <QList>
+#include <QVariantMap>
+#include <QTimer>
+#include <atomic>
 
 #include "openniapplication.h"
+#include "sessionrecorder.h"
+#include "usbdevices.h"
+#include "autotiltcontroller.h"
+#include "poseextractor.h"
+
+// Maximum time to wait for the stop of the frame loop (in ms)
+#define OPENNI_STOP_TIMEOUT 3000
+// Time to wait after a Kinect device is plugged before using it (in ms)
+// All devices of the sensor are added in this interval
+#define SENSOR_PLUG_DELAY 1500
 
 // Used to manage OpenNI main loop
+// When a Kinect is used, the loop is stopped if the sensor is unplugged
+// and started again when a sensor is plugged.
+//
+// Supported options:
+// - "source": "openni" (default) to use a connected sensor, or "replay"
+// - "replayFile": session to replay (see SessionRecorder), synthetic frames are used if empty
+// - "replaySpeed": 1 for real time (default), 2 for twice as fast, ..., 0 for as fast as possible
+// - "replayLoop": restart the session at its end (default: false)
+// - "autoTilt": move the sensor to keep the user in the image (default: false)
+// - "stallTimeout": maximum time without frame from the sensor (in ms) before it is
+//   re-initialized, 0 to disable (default: DEFAULT_STALL_TIMEOUT)
+// - "processingPolicy", "publicationPolicy": "keepAll" to process every frame waiting for
+//   the stage, "dropOldest" to only process the newest one (default: keepAll and dropOldest)
+// - "player": name of the player, used to save and reload the skeleton calibration
+//   (default: empty, which disables the calibration profiles). The first calibration is saved
+//   and never overwritten, delete the profile to calibrate the player again
+// - "joints": comma-separated joints extracted from the skeletons, among "torso", "leftHip", "rightHip",
+//   "leftKnee", "rightKnee", "leftFoot", "rightFoot", "leftShoulder" and "rightShoulder"
+//   (default: all). The rotation and the walk speed only use the joints extracted
+// - "depthMode": resolution of the depth maps given as "WIDTHxHEIGHT", optionally followed
+//   by "@FPS" (the highest frame rate is used otherwise), e.g. "320x240" (default: sensor mode)
+// - "filter": smoothing of the rotation and of the walk speed, "none", "oneEuro" (default),
+//   "criticallyDamped" or "kalman" (see FilterSettings for the parameters)
+// - "rotationMinCutoff", "rotationBeta", "rotationResponseTime", "rotationProcessNoise",
+//   "rotationMeasurementNoise" and the same options prefixed by "speed": parameters of the
+//   filters, in seconds, Hz, degrees and cm/s (default: defaultRotationFilter() and defaultSpeedFilter())
+// - "predictionHorizon": time between the read of the values and their use by the headset (in ms),
+//   the values are extrapolated by this time plus the age of the frame, a negative value disables
+//   the prediction (default: DEFAULT_PREDICTION_HORIZON)
+// - "depthPalette": colors of the depth map shown by OpenNIControllerWidget, "gray" (default),
+//   "turbo" or "nearRange" (can be changed in the widget)
+// - "depthRange": depths (in mm) covered by the palette given as "NEAR-FAR", e.g. "800-2500"
+//   (default: depends on the palette, see DepthColorTable::defaultRange())
 class OpenNIWorker : public QObject
 {
         Q_OBJECT
 
     public:
-        OpenNIWorker(int frequency, QObject *parent = nullptr);
+        OpenNIWorker(const QVariantMap& options, QObject *parent = nullptr);
         ~OpenNIWorker();
 
     public slots:
+        // Start the frame loop (only returns when the loop is stopped)
         void launch();
 
         void setMotorAngle(const int angle);
+        // Can be called from any thread
+        void setAutoTilt(const bool enabled);
+        bool isAutoTiltEnabled() const;
+        // Stop the frame loop for good (no relaunch when a sensor is plugged)
+        // Can be called from any thread
         void requestStop();
 
+        // See OpenNIApplication::selectUser()
+        void selectUser(const int userID);
+        QList<int> userIDs();
+
         int orientationValue();
         int walkSpeedValue();
         int specialCode();
 
+        // Informations used to compute the sent values, their age is recorded by dataSent()
         OpenNIUtil::CameraInformations camInfo();
+        // Add the age of the informations last read by camInfo() to the data age
+        // Called once per send, whatever the number of values read
+        void dataSent();
+        // Same as camInfo(), but the read isn't used for the data age (used to draw the image)
+        OpenNIUtil::CameraInformations lastCamInfo();
+        DepthFrame depthFrame();
+
+        // Latencies of all stages, can be used from any thread
+        PipelineStats& stats();
+        // Number of stalls of the sensor (see OpenNIApplication)
+        int stalls() const;
+
+        // Record all frames in a session file (see SessionRecorder)
+        // Can be called from any thread
+        bool startRecording(const QString& path, const bool withDepth);
+        void stopRecording();
+        bool isRecording() const;
+
+    signals:
+        // Forwarded from the OpenNI application (emitted in its publication thread)
+        void frameReady(quint32 frameNumber, bool userTracked);
+        // Emitted when the motor is moved by the automatic tilt (in the publication thread)
+        void motorAngleChanged(int angle);
 
     private:
+        // Find the first connected Kinect
+        // Return nullptr if there is no sensor
+        SensorSource *createOpenNISource();
+        // File of the calibration profile of the player (empty if disabled)
+        QString calibrationFile() const;
+
+        // Time (in µs) the values of the frame are extrapolated by
+        int64_t predictionTime(const OpenNIUtil::CameraInformations& info) const;
+
+        // Called in the publication thread after each frame, must never block
+        void processFrame();
 
-        int _frequency;
+        // Ask the frame loop to stop, it can be launched again later
+        // Can be called from any thread
+        void stopLoop();
+
+        // Only used with a Kinect
+        // The monitor is kept in the thread of the creator, since the worker thread
+        // is busy with the frame loop
+        USBHotplugMonitor *_hotplugMonitor = nullptr;
+        QTimer *_relaunchTimer = nullptr;
+        // Bus and device numbers of the camera used
+        std::atomic<int> _cameraBus{-1};
+        std::atomic<int> _cameraDevice{-1};
+
+        // Only state used by the other threads to stop the frame loop: the app is only
+        // created, reset, initialized and released in the worker thread
+        std::atomic<OpenNIApplication*> _loopApp{nullptr};
+        std::atomic<bool> _stopRequested{false};
+
+        QVariantMap _options;
+        FilterSettings _rotationFilter;
+        FilterSettings _speedFilter;
+        // In µs, -1 if disabled
+        int64_t _predictionHorizon = -1;
         int _specialCode = 0;
+        // Age (in µs) of the informations last read by camInfo(), -1 if already recorded
+        int64_t _readAge = -1;
+        // Kept here since the app may not be created yet
+        std::atomic<int> _selectedUser{0};
 
         OpenNIApplication *_app = nullptr;
 
+        PipelineStats _stats;
+
+        OpenNIUtil::DepthMode _depthMode;
+        JointMask _jointMask = DEFAULT_JOINT_MASK;
+
+        SessionRecorder _recorder;
+
+        AutoTiltController _autoTilt;
+        std::atomic<bool> _autoTiltEnabled{false};
+        // Only used in the publication thread
+        bool _autoTiltWasEnabled = false;
+
 };
 
 #endif // OPENNIPROCESSWORKER
@@ -0,0 +1,121 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PIPELINEQUEUE_H
+#define PIPELINEQUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+#include "spscqueue.h"
+
+// What the consumer of a PipelineQueue does with the waiting values
+enum class DropPolicy
+{
+    // Process all values in order (the producer drops the new values if the queue is full)
+    KeepAll,
+    // Only process the newest value, the older ones are dropped
+    DropOldest
+};
+
+// SPSCQueue connecting two threads of a pipeline.
+// The consumer sleeps while the queue is empty, the producer never blocks.
+template<typename T, uint32_t Capacity>
+class PipelineQueue
+{
+    public:
+        PipelineQueue() {}
+
+        PipelineQueue(const PipelineQueue&) = delete;
+        PipelineQueue& operator=(const PipelineQueue&) = delete;
+
+        // Must not be called while the queue is used
+        void setPolicy(const DropPolicy policy)
+        {
+            _policy = policy;
+        }
+
+        // Only called by the producer
+        // Return false if the queue is full (the value is dropped)
+        bool push(T&& value)
+        {
+            if(!_queue.push(std::move(value)))
+                return false;
+            wake();
+            return true;
+        }
+
+        // Only called by the producer
+        // The consumer gets the remaining values, then pop() fails
+        void close()
+        {
+            _closed = true;
+            wake();
+        }
+
+        // Must not be called while the queue is used
+        void reopen()
+        {
+            _closed = false;
+        }
+
+        // Only called by the consumer
+        // Wait for a value, return false if the queue is closed and empty
+        // The number of values dropped by the policy is added to dropped
+        bool pop(T& value, uint64_t *dropped = nullptr)
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _condition.wait(lock, [this]() { return !_queue.isEmpty() || _closed.load(); });
+            }
+
+            if(!_queue.pop(value))
+                return false;
+
+            if(_policy == DropPolicy::DropOldest)
+            {
+                while(_queue.pop(value))
+                {
+                    if(dropped != nullptr)
+                        ++(*dropped);
+                }
+            }
+            return true;
+        }
+
+    private:
+        void wake()
+        {
+            // Taking the lock avoids a lost wake-up between the check and the wait of the consumer
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+            }
+            _condition.notify_one();
+        }
+
+        SPSCQueue<T, Capacity> _queue;
+        DropPolicy _policy = DropPolicy::KeepAll;
+        std::atomic<bool> _closed{false};
+
+        std::mutex _mutex;
+        std::condition_variable _condition;
+};
+
+#endif // PIPELINEQUEUE_H
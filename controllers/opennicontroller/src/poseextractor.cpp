@@ -0,0 +1,98 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "poseextractor.h"
+
+// All joints stored in the User structure
+static const XnSkeletonJoint userJoints[] = {
+    XN_SKEL_TORSO,
+    XN_SKEL_LEFT_HIP, XN_SKEL_LEFT_KNEE, XN_SKEL_LEFT_FOOT, XN_SKEL_LEFT_SHOULDER,
+    XN_SKEL_RIGHT_HIP, XN_SKEL_RIGHT_KNEE, XN_SKEL_RIGHT_FOOT, XN_SKEL_RIGHT_SHOULDER
+};
+
+PoseExtractor::PoseExtractor(xn::UserGenerator& userGenerator, xn::DepthGenerator& depthGenerator):
+    _userGenerator(userGenerator), _depthGenerator(depthGenerator)
+{
+}
+
+void PoseExtractor::setJoints(const JointMask mask)
+{
+    _requestedMask = mask;
+    buildJointList();
+}
+
+JointMask PoseExtractor::joints() const
+{
+    return _requestedMask;
+}
+
+void PoseExtractor::updateActiveJoints()
+{
+    XnSkeletonJoint activeJoints[MAX_EXTRACTED_JOINTS];
+    XnUInt16 activeCount = MAX_EXTRACTED_JOINTS;
+    _activeMask = 0;
+    if(_userGenerator.GetSkeletonCap().EnumerateActiveJoints(activeJoints, activeCount) == XN_STATUS_OK)
+    {
+        for(XnUInt16 i=0; i < activeCount; ++i)
+            _activeMask |= JOINT_BIT(activeJoints[i]);
+    }
+
+    buildJointList();
+}
+
+void PoseExtractor::extract(const XnUserID userID, OpenNIUtil::User *user)
+{
+    for(const XnSkeletonJoint type : userJoints)
+    {
+        OpenNIUtil::Joint *joint = OpenNIUtil::jointOfUser(user, type);
+        joint->type = type;
+        joint->isActive = false;
+    }
+
+    for(int i=0; i < _jointsCount; ++i)
+    {
+        _userGenerator.GetSkeletonCap().GetSkeletonJointPosition(userID, _jointTypes[i], _positions[i]);
+        _realWorld[i] = _positions[i].position;
+    }
+
+    // Convert all positions at once
+    if(_jointsCount > 0)
+        _depthGenerator.ConvertRealWorldToProjective(_jointsCount, _realWorld, _projective);
+
+    for(int i=0; i < _jointsCount; ++i)
+    {
+        OpenNIUtil::Joint *joint = OpenNIUtil::jointOfUser(user, _jointTypes[i]);
+        if(joint == nullptr)
+            continue;
+        joint->isActive = true;
+        joint->info = _positions[i];
+        joint->projectivePos = _projective[i];
+    }
+}
+
+// Private
+void PoseExtractor::buildJointList()
+{
+    const JointMask mask = _requestedMask & _activeMask;
+    _jointsCount = 0;
+    for(int type=1; type <= MAX_EXTRACTED_JOINTS; ++type)
+    {
+        if(mask & JOINT_BIT(type))
+            _jointTypes[_jointsCount++] = static_cast<XnSkeletonJoint>(type);
+    }
+}
@@ -0,0 +1,77 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef POSEEXTRACTOR_H
+#define POSEEXTRACTOR_H
+
+#include <ni/XnCppWrapper.h>
+#include <cstdint>
+
+#include "openniutil.h"
+
+// Set of joints, one bit per XnSkeletonJoint value
+typedef uint32_t JointMask;
+#define JOINT_BIT(joint) (1u << (joint))
+
+// Joints used to compute the rotation and the walk speed
+#define DEFAULT_JOINT_MASK (JOINT_BIT(XN_SKEL_TORSO)                                                     \
+                            | JOINT_BIT(XN_SKEL_LEFT_HIP) | JOINT_BIT(XN_SKEL_RIGHT_HIP)                 \
+                            | JOINT_BIT(XN_SKEL_LEFT_KNEE) | JOINT_BIT(XN_SKEL_RIGHT_KNEE)               \
+                            | JOINT_BIT(XN_SKEL_LEFT_FOOT) | JOINT_BIT(XN_SKEL_RIGHT_FOOT)               \
+                            | JOINT_BIT(XN_SKEL_LEFT_SHOULDER) | JOINT_BIT(XN_SKEL_RIGHT_SHOULDER))
+
+// XnSkeletonJoint values are in range [1;24]
+#define MAX_EXTRACTED_JOINTS 24
+
+// Extract the joints of a user in one pass:
+// all positions are fetched in a contiguous array and converted
+// to projective coordinates with a single call.
+class PoseExtractor
+{
+    public:
+        PoseExtractor(xn::UserGenerator& userGenerator, xn::DepthGenerator& depthGenerator);
+
+        // Set the joints to extract
+        // Joints not active in the current skeleton profile are never queried
+        void setJoints(const JointMask mask);
+        JointMask joints() const;
+
+        // Must be called when the skeleton profile changes
+        void updateActiveJoints();
+
+        // Fill the joints of the user
+        void extract(const XnUserID userID, OpenNIUtil::User *user);
+
+    private:
+        void buildJointList();
+
+        xn::UserGenerator& _userGenerator;
+        xn::DepthGenerator& _depthGenerator;
+
+        JointMask _requestedMask = DEFAULT_JOINT_MASK;
+        JointMask _activeMask = 0;
+
+        // Joints queried at each extraction
+        int _jointsCount = 0;
+        XnSkeletonJoint _jointTypes[MAX_EXTRACTED_JOINTS];
+        XnSkeletonJointPosition _positions[MAX_EXTRACTED_JOINTS];
+        XnPoint3D _realWorld[MAX_EXTRACTED_JOINTS];
+        XnPoint3D _projective[MAX_EXTRACTED_JOINTS];
+};
+
+#endif // POSEEXTRACTOR_H
@@ -0,0 +1,189 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "posefilter.h"
+#include "openniutil.h"
+
+#include <cmath>
+
+FilterSettings defaultRotationFilter()
+{
+    FilterSettings settings;
+    settings.minCutoff = 1.0f;
+    settings.beta = 0.05f;
+    settings.responseTime = 0.08f;
+    settings.processNoise = 100.0f;
+    settings.measurementNoise = 3.0f;
+    return settings;
+}
+
+FilterSettings defaultSpeedFilter()
+{
+    FilterSettings settings;
+    settings.minCutoff = 0.5f;
+    settings.beta = 0.005f;
+    settings.responseTime = 0.25f;
+    settings.processNoise = 300.0f;
+    settings.measurementNoise = 20.0f;
+    return settings;
+}
+
+// Smoothing factor of an exponential filter with this cutoff (in Hz) for a period dt (in s)
+static float smoothingFactor(const float cutoff, const float dt)
+{
+    const float tau = 1.0f / (2.0f * static_cast<float>(PI) * cutoff);
+    return 1.0f / (1.0f + tau / dt);
+}
+
+//
+// ScalarFilter
+//
+
+void ScalarFilter::reset()
+{
+    _initialized = false;
+}
+
+float ScalarFilter::filter(const FilterSettings& settings, const float value, const int64_t timestamp)
+{
+    if(settings.type == FilterType::None)
+        return value;
+
+    if(!_initialized || timestamp - _timestamp > FILTER_RESET_INTERVAL)
+    {
+        _initialized = true;
+        _timestamp = timestamp;
+        _value = value;
+        _raw = value;
+        _velocity = 0.0f;
+        _p00 = settings.measurementNoise * settings.measurementNoise;
+        _p01 = 0.0f;
+        _p11 = settings.processNoise * settings.processNoise;
+        return value;
+    }
+
+    // Same sensor frame
+    if(timestamp <= _timestamp)
+        return _value;
+
+    const float dt = (timestamp - _timestamp) * 0.000001f;
+    _timestamp = timestamp;
+
+    switch(settings.type)
+    {
+        case FilterType::OneEuro:
+        {
+            const float rawVelocity = (value - _raw) / dt;
+            _raw = value;
+            _velocity += smoothingFactor(settings.derivativeCutoff, dt) * (rawVelocity - _velocity);
+            const float cutoff = settings.minCutoff + settings.beta * std::abs(_velocity);
+            _value += smoothingFactor(cutoff, dt) * (value - _value);
+            break;
+        }
+        case FilterType::CriticallyDamped:
+        {
+            // Exact solution of x'' = w²(value - x) - 2w x' over dt, stable for any period
+            const float omega = 1.0f / settings.responseTime;
+            const float error = _value - value;
+            const float decay = std::exp(-omega * dt);
+            const float temp = (_velocity + omega * error) * dt;
+            _value = value + (error + temp) * decay;
+            _velocity = (_velocity - omega * temp) * decay;
+            break;
+        }
+        case FilterType::Kalman:
+        {
+            // Predict, the acceleration is a white noise
+            const float q = settings.processNoise * settings.processNoise;
+            _value += _velocity * dt;
+            _p00 += dt * (2.0f * _p01 + dt * _p11) + q * dt * dt * dt / 3.0f;
+            _p01 += dt * _p11 + q * dt * dt / 2.0f;
+            _p11 += q * dt;
+
+            // Update with the measure
+            const float s = _p00 + settings.measurementNoise * settings.measurementNoise;
+            const float k0 = _p00 / s;
+            const float k1 = _p01 / s;
+            const float innovation = value - _value;
+            _value += k0 * innovation;
+            _velocity += k1 * innovation;
+            _p11 -= k1 * _p01;
+            _p00 -= k0 * _p00;
+            _p01 -= k0 * _p01;
+            break;
+        }
+        default:
+            _value = value;
+            break;
+    }
+
+    return _value;
+}
+
+float ScalarFilter::filterAngle(const FilterSettings& settings, const float angle, const int64_t timestamp)
+{
+    // Unwrap the angle around the filtered one, so 359° -> 1° is a step of 2°
+    float unwrapped = angle;
+    if(_initialized)
+    {
+        unwrapped = _value + OpenNIUtil::angleDifference(angle, _value);
+        // Keep the state close to [0;360[
+        if(_value >= 360.0f || _value < 0.0f)
+        {
+            const float turns = std::floor(_value / 360.0f) * 360.0f;
+            _value -= turns;
+            _raw -= turns;
+            unwrapped -= turns;
+        }
+    }
+
+    const float filtered = std::fmod(filter(settings, unwrapped, timestamp), 360.0f);
+    return filtered < 0.0f ? filtered + 360.0f : filtered;
+}
+
+//
+// FilterStats
+//
+
+void FilterStats::add(const float raw, const float previousRaw, const float filtered, const float previousFiltered,
+                      const bool angle)
+{
+    if(angle)
+    {
+        _rawSteps += std::abs(OpenNIUtil::angleDifference(raw, previousRaw));
+        _filteredSteps += std::abs(OpenNIUtil::angleDifference(filtered, previousFiltered));
+        _deviation += std::abs(OpenNIUtil::angleDifference(filtered, raw));
+    }
+    else
+    {
+        _rawSteps += std::abs(raw - previousRaw);
+        _filteredSteps += std::abs(filtered - previousFiltered);
+        _deviation += std::abs(filtered - raw);
+    }
+    ++_samples;
+}
+
+QString FilterStats::report(const QString& name, const QString& unit) const
+{
+    if(_samples == 0)
+        return QStringLiteral("%1: no samples").arg(name);
+
+    return QStringLiteral("%1: mean step %2 %3 (raw %4 %3), mean deviation from raw %5 %3 (%6 samples)")
+            .arg(name).arg(_filteredSteps / _samples, 0, 'f', 2).arg(unit)
+            .arg(_rawSteps / _samples, 0, 'f', 2).arg(_deviation / _samples, 0, 'f', 2).arg(_samples);
+}
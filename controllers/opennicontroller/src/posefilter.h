@@ -0,0 +1,112 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef POSEFILTER_H
+#define POSEFILTER_H
+
+#include <QString>
+#include <cstdint>
+
+// Above this time without value (in µs), a filter restarts from the new value
+#define FILTER_RESET_INTERVAL 500000
+
+enum class FilterType
+{
+    // The raw values are used
+    None,
+    // Adaptive low-pass filter: low jitter when the value is stable, low lag when it moves
+    // See <http://cristal.univ-lille.fr/~casiez/1euro/>
+    OneEuro,
+    // Second order system following the values without overshoot
+    CriticallyDamped,
+    // Kalman filter with a constant velocity model
+    Kalman
+};
+
+// Parameters of a filter, in real time units (the filters don't depend on the frame rate)
+// The unit is the one of the filtered value (degrees for the rotation, cm/s for the speed)
+struct FilterSettings
+{
+    FilterType type = FilterType::OneEuro;
+
+    // One euro: cutoff frequency when the value is stable (in Hz), increase of the cutoff
+    // with the speed of the value (in Hz per unit/s) and cutoff of the speed (in Hz)
+    // Lower minCutoff to reduce the jitter, raise beta to reduce the lag
+    float minCutoff = 1.0f;
+    float beta = 0.0f;
+    float derivativeCutoff = 1.0f;
+
+    // Critically damped: time constant (in s), the lag grows with it
+    float responseTime = 0.1f;
+
+    // Kalman: standard deviations of the acceleration (in unit/s²) and of the measures (in unit)
+    // Raise the process noise to reduce the lag, raise the measurement noise to reduce the jitter
+    float processNoise = 100.0f;
+    float measurementNoise = 5.0f;
+};
+
+// Defaults for the rotation (in degrees) and the walk speed (in cm/s)
+FilterSettings defaultRotationFilter();
+FilterSettings defaultSpeedFilter();
+
+// Filter of a single value, driven by the timestamps of the sensor.
+// This is a plain value (no allocation), so it can be stored in tables.
+class ScalarFilter
+{
+    public:
+        void reset();
+
+        // Return the filtered value at the timestamp (in µs)
+        float filter(const FilterSettings& settings, const float value, const int64_t timestamp);
+        // Same for an angle in degrees, the result is in range [0;360[
+        float filterAngle(const FilterSettings& settings, const float angle, const int64_t timestamp);
+
+    private:
+        bool _initialized = false;
+        int64_t _timestamp = 0;
+
+        float _value = 0.0f;
+        float _velocity = 0.0f;
+        // One euro: previous raw value
+        float _raw = 0.0f;
+        // Kalman: covariance of the estimation
+        float _p00 = 0.0f;
+        float _p01 = 0.0f;
+        float _p11 = 0.0f;
+};
+
+// Measures of a filter on a sequence of values, used to compare the settings on a recorded session
+class FilterStats
+{
+    public:
+        // The previous values are the ones of the same user
+        void add(const float raw, const float previousRaw, const float filtered, const float previousFiltered,
+                 const bool angle);
+
+        // Mean distance between two consecutive filtered values (the jitter)
+        // and between the raw and the filtered values (mostly the lag)
+        QString report(const QString& name, const QString& unit) const;
+
+    private:
+        uint64_t _samples = 0;
+        double _rawSteps = 0.0;
+        double _filteredSteps = 0.0;
+        double _deviation = 0.0;
+};
+
+#endif // POSEFILTER_H
@@ -0,0 +1,91 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "renderworker.h"
+
+RenderWorker::RenderWorker(OpenNIWorker *openniWorker, QObject *parent): QObject(parent)
+{
+    qRegisterMetaType<std::shared_ptr<const cv::Mat>>();
+
+    _openniWorker = openniWorker;
+}
+
+void RenderWorker::requestRender()
+{
+    // A render is already waiting, it will draw the newest frame
+    if(_renderQueued.exchange(true))
+    {
+        _openniWorker->stats().stage(PipelineStage::Render).addSkipped();
+        return;
+    }
+
+    QMetaObject::invokeMethod(this, "render", Qt::QueuedConnection);
+}
+
+void RenderWorker::imageShown()
+{
+    _imagePending = false;
+    // Draw the frame which came while the GUI was busy
+    if(_renderMissed.exchange(false))
+        requestRender();
+}
+
+// Public slots
+void RenderWorker::setPalette(int palette, int nearDepth, int farDepth)
+{
+    // The table is only rebuilt if something changed
+    _depthColors.setPalette(static_cast<DepthPalette>(palette), nearDepth, farDepth);
+}
+
+// Private slots
+void RenderWorker::render()
+{
+    // Cleared first, so a frame published while drawing queues another render
+    _renderQueued = false;
+
+    // The GUI hasn't shown the last image yet, imageShown() requests the render again
+    // The flag is set before the check, so a concurrent imageShown() can't miss it
+    if(_renderMissed.exchange(true))
+        _openniWorker->stats().stage(PipelineStage::Render).addSkipped();
+    if(_imagePending)
+        return;
+    _renderMissed = false;
+
+    const OpenNIUtil::CameraInformations camInfo = _openniWorker->lastCamInfo();
+    // Polling may request the same frame twice
+    if(camInfo.invalid || camInfo.frameNumber == _lastRenderedFrame)
+        return;
+
+    LatencyTimer renderTimer;
+
+    // Keep the handle until the image is drawn
+    const DepthFrame depthFrame = _openniWorker->depthFrame();
+    std::shared_ptr<const cv::Mat> image = _hudRenderer.render(camInfo, depthFrame, _depthColors);
+    // Both images are still held by the viewer
+    if(!image)
+    {
+        _openniWorker->stats().stage(PipelineStage::Render).addSkipped();
+        return;
+    }
+
+    _openniWorker->stats().addSample(PipelineStage::Render, renderTimer.elapsed());
+    _lastRenderedFrame = camInfo.frameNumber;
+
+    _imagePending = true;
+    emit imageReady(std::move(image));
+}
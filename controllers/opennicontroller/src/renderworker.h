@@ -0,0 +1,83 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RENDERWORKER_H
+#define RENDERWORKER_H
+
+#include <QObject>
+#include <QMetaType>
+#include <atomic>
+#include <memory>
+
+#include "hudrenderer.h"
+#include "openniworker.h"
+
+Q_DECLARE_METATYPE(std::shared_ptr<const cv::Mat>)
+
+// Draw the images of the frames in its own thread (see HudRenderer),
+// so the GUI thread, which also sends the data, only uploads them.
+//
+// The worker never queues more than one frame: requestRender() doesn't block,
+// and the frames coming while a render is waiting, or while the GUI hasn't
+// shown the last image yet, are dropped (only the newest frame is drawn).
+// The drawing is measured in the Render stage of the pipeline statistics,
+// the dropped frames are counted as skipped.
+class RenderWorker : public QObject
+{
+        Q_OBJECT
+
+    public:
+        // The OpenNI worker must live longer than this worker
+        RenderWorker(OpenNIWorker *openniWorker, QObject *parent = nullptr);
+
+        // Draw the last frame as soon as possible
+        // Can be called from any thread
+        void requestRender();
+        // Called by the GUI when the last image is shown, the next frame can be drawn
+        // Can be called from any thread
+        void imageShown();
+
+    public slots:
+        // Use queued calls from the other threads
+        // The palette is a DepthPalette, see DepthColorTable::setPalette()
+        void setPalette(int palette, int nearDepth, int farDepth);
+
+    signals:
+        void imageReady(std::shared_ptr<const cv::Mat> image);
+
+    private slots:
+        void render();
+
+    private:
+        OpenNIWorker *_openniWorker;
+
+        HudRenderer _hudRenderer;
+        DepthColorTable _depthColors;
+
+        // Set when a call of render() is queued
+        std::atomic<bool> _renderQueued{false};
+        // Set from the emission of imageReady() to the call of imageShown()
+        std::atomic<bool> _imagePending{false};
+        // Set when a frame wasn't drawn because the last image wasn't shown
+        std::atomic<bool> _renderMissed{false};
+
+        // Used to skip already drawn frames
+        quint32 _lastRenderedFrame = 0;
+};
+
+#endif // RENDERWORKER_H
@@ -0,0 +1,278 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "replaysensorsource.h"
+#include "core/latencystats.h"
+
+#include <QDebug>
+
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+// Time between two frames of the sensor (in µs)
+#define NOMINAL_FRAME_INTERVAL (1000000 / SYNTHETIC_FRAME_FREQUENCY)
+
+// Focal length used to project the synthetic joints (in pixels)
+#define SYNTHETIC_FOCAL_LENGTH 525.0f
+
+ReplaySensorSource::ReplaySensorSource(const QString& path, const double speed, const bool loop)
+{
+    _path = path;
+    _speed = speed;
+    _loop = loop;
+}
+
+XnStatus ReplaySensorSource::init()
+{
+    if(_path.isEmpty())
+    {
+        qDebug() << qPrintable(tr("Initializing the replay of synthetic frames ..."));
+
+        // A flat background with the user in the middle
+        _syntheticDepth.reset(new XnDepthPixel[DEFAULT_DEPTH_MAP_WIDTH * DEFAULT_DEPTH_MAP_HEIGHT]);
+        for(int y=0; y < DEFAULT_DEPTH_MAP_HEIGHT; ++y)
+        {
+            for(int x=0; x < DEFAULT_DEPTH_MAP_WIDTH; ++x)
+            {
+                const bool inUser = std::abs(x - DEFAULT_DEPTH_MAP_WIDTH/2) < 50 && y > DEFAULT_DEPTH_MAP_HEIGHT/5 && y < DEFAULT_DEPTH_MAP_HEIGHT*9/10;
+                _syntheticDepth[y*DEFAULT_DEPTH_MAP_WIDTH + x] = inUser ? SYNTHETIC_BACKGROUND_DEPTH/2 : SYNTHETIC_BACKGROUND_DEPTH;
+            }
+        }
+        return XN_STATUS_OK;
+    }
+
+    qDebug() << qPrintable(tr("Initializing the replay of %1 ...").arg(_path));
+
+    if(!_reader.open(_path))
+        return 40;
+
+    if(_reader.frameCount() == 0)
+    {
+        qCritical() << qPrintable(tr("The session %1 doesn't contain any frame !").arg(_path));
+        return 41;
+    }
+
+    _depthSupported = _reader.depthWidth() > 0 && _reader.depthHeight() > 0
+                      && uint64_t(_reader.depthWidth()) * _reader.depthHeight() <= MAX_DEPTH_MAP_LENGTH;
+    if(!_depthSupported)
+        qWarning() << qPrintable(tr("The depth maps of the session have an unsupported size (%1x%2), they are ignored.")
+                                 .arg(_reader.depthWidth()).arg(_reader.depthHeight()));
+
+    return XN_STATUS_OK;
+}
+
+XnStatus ReplaySensorSource::start()
+{
+    _nextIndex = 0;
+    _timestampOffset = 0;
+    _frameIDOffset = 0;
+
+    _hasNext = loadNext();
+    _firstTimestamp = _next.sensorTimestamp;
+    _startTime = LatencyTimer::now();
+
+    if(_speed > 0.0)
+        qDebug() << qPrintable(tr("Replay started at %1x the real time.").arg(_speed));
+    else
+        qDebug() << qPrintable(tr("Replay started as fast as possible."));
+
+    return XN_STATUS_OK;
+}
+
+void ReplaySensorSource::release()
+{
+    _reader.close();
+    _hasNext = false;
+    _currentDepth = nullptr;
+    _nextDepth = nullptr;
+}
+
+bool ReplaySensorSource::waitForNewFrame(const int timeout)
+{
+    // Let update() report the end of the session
+    if(!_hasNext || _speed <= 0.0)
+        return true;
+
+    const int64_t dueTime = _startTime + static_cast<int64_t>((_next.sensorTimestamp - _firstTimestamp) / _speed);
+    const int64_t delay = dueTime - LatencyTimer::now();
+    if(delay > timeout * 1000LL)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeout));
+        return false;
+    }
+
+    if(delay > 0)
+        std::this_thread::sleep_for(std::chrono::microseconds(delay));
+    return true;
+}
+
+bool ReplaySensorSource::update()
+{
+    if(!_hasNext)
+    {
+        qDebug() << qPrintable(tr("End of the replayed session."));
+        return false;
+    }
+
+    _current = _next;
+    _currentDepth = _nextDepth;
+    _hasNext = loadNext();
+    return true;
+}
+
+bool ReplaySensorSource::isUserDataNew() const
+{
+    // Each recorded frame was processed
+    return true;
+}
+
+uint32_t ReplaySensorSource::frameID() const
+{
+    return _current.sensorFrameID;
+}
+
+int64_t ReplaySensorSource::timestamp() const
+{
+    return _current.sensorTimestamp;
+}
+
+const XnDepthPixel *ReplaySensorSource::depthMap() const
+{
+    return _currentDepth;
+}
+
+int ReplaySensorSource::depthWidth() const
+{
+    return _path.isEmpty() || !_depthSupported ? DEFAULT_DEPTH_MAP_WIDTH : _reader.depthWidth();
+}
+
+int ReplaySensorSource::depthHeight() const
+{
+    return _path.isEmpty() || !_depthSupported ? DEFAULT_DEPTH_MAP_HEIGHT : _reader.depthHeight();
+}
+
+int ReplaySensorSource::trackedUsers(XnUserID *ids, const int maxCount)
+{
+    // Only the selected user was recorded
+    if(!_current.user.isTracking || maxCount < 1)
+        return 0;
+
+    ids[0] = _current.user.id;
+    return 1;
+}
+
+void ReplaySensorSource::extractUser(const XnUserID /*userID*/, OpenNIUtil::User *user)
+{
+    user->torsoJoint = _current.user.torsoJoint;
+    user->leftPart = _current.user.leftPart;
+    user->rightPart = _current.user.rightPart;
+}
+
+// Private
+uint64_t ReplaySensorSource::framesCount() const
+{
+    return _path.isEmpty() ? std::numeric_limits<uint64_t>::max() : _reader.frameCount();
+}
+
+void ReplaySensorSource::readFrame(const uint64_t index, OpenNIUtil::CameraInformations *camInfo, const XnDepthPixel **depthMap)
+{
+    if(_path.isEmpty())
+    {
+        generateFrame(index, camInfo);
+        *depthMap = _syntheticDepth.get();
+        return;
+    }
+
+    _reader.readFrame(index, camInfo, depthMap);
+    if(!_depthSupported)
+        *depthMap = nullptr;
+}
+
+bool ReplaySensorSource::loadNext()
+{
+    if(_nextIndex >= framesCount())
+    {
+        if(!_loop)
+            return false;
+
+        // Restart from the first frame, after the last one
+        OpenNIUtil::CameraInformations first;
+        OpenNIUtil::CameraInformations last;
+        const XnDepthPixel *depthMap;
+        readFrame(0, &first, &depthMap);
+        readFrame(framesCount() - 1, &last, &depthMap);
+
+        _timestampOffset += last.sensorTimestamp - first.sensorTimestamp + NOMINAL_FRAME_INTERVAL;
+        _frameIDOffset += last.sensorFrameID - first.sensorFrameID + 1;
+        _nextIndex = 0;
+    }
+
+    readFrame(_nextIndex++, &_next, &_nextDepth);
+    _next.sensorTimestamp += _timestampOffset;
+    _next.sensorFrameID += _frameIDOffset;
+    return true;
+}
+
+void ReplaySensorSource::generateFrame(const uint64_t index, OpenNIUtil::CameraInformations *camInfo)
+{
+    *camInfo = OpenNIUtil::CameraInformations();
+    camInfo->sensorFrameID = static_cast<uint32_t>(index + 1);
+    camInfo->sensorTimestamp = static_cast<int64_t>(index) * NOMINAL_FRAME_INTERVAL;
+
+    OpenNIUtil::User& user = camInfo->user;
+    user.id = 1;
+    user.isTracking = true;
+    user.timestamp = camInfo->sensorTimestamp;
+
+    const float time = static_cast<float>(index) / SYNTHETIC_FRAME_FREQUENCY;
+    // One step per second, and a slow turn of +/- 30°
+    const float step = std::sin(2.0f * static_cast<float>(PI) * time);
+    const float heading = 30.0f * std::sin(2.0f * static_cast<float>(PI) * time / 20.0f) * static_cast<float>(DEG2RAD);
+    const float leftLift = step > 0.0f ? 400.0f * step : 0.0f;
+    const float rightLift = step < 0.0f ? -400.0f * step : 0.0f;
+
+    // Positions are given in the user frame (in mm), then turned and moved in front of the sensor
+    auto setJoint = [heading](OpenNIUtil::Joint& joint, const XnSkeletonJoint type, const float x, const float y, const float z) {
+        joint.type = type;
+        joint.isActive = true;
+        joint.info.fConfidence = 1.0f;
+        joint.info.position.X = x * std::cos(heading) - z * std::sin(heading);
+        joint.info.position.Y = y;
+        joint.info.position.Z = x * std::sin(heading) + z * std::cos(heading) + SYNTHETIC_BACKGROUND_DEPTH/2;
+        joint.projectivePos.X = DEFAULT_DEPTH_MAP_WIDTH/2 + SYNTHETIC_FOCAL_LENGTH * joint.info.position.X / joint.info.position.Z;
+        joint.projectivePos.Y = DEFAULT_DEPTH_MAP_HEIGHT/2 - SYNTHETIC_FOCAL_LENGTH * joint.info.position.Y / joint.info.position.Z;
+        joint.projectivePos.Z = joint.info.position.Z;
+    };
+
+    setJoint(user.torsoJoint, XN_SKEL_TORSO, 0.0f, 0.0f, 0.0f);
+
+    setJoint(user.leftPart.shoulder, XN_SKEL_LEFT_SHOULDER, -200.0f, 400.0f, 0.0f);
+    setJoint(user.leftPart.hip, XN_SKEL_LEFT_HIP, -120.0f, -200.0f, 0.0f);
+    setJoint(user.leftPart.knee, XN_SKEL_LEFT_KNEE, -120.0f, -600.0f + leftLift/2, -leftLift/2);
+    setJoint(user.leftPart.foot, XN_SKEL_LEFT_FOOT, -120.0f, -1000.0f + leftLift, -leftLift);
+
+    setJoint(user.rightPart.shoulder, XN_SKEL_RIGHT_SHOULDER, 200.0f, 400.0f, 0.0f);
+    setJoint(user.rightPart.hip, XN_SKEL_RIGHT_HIP, 120.0f, -200.0f, 0.0f);
+    setJoint(user.rightPart.knee, XN_SKEL_RIGHT_KNEE, 120.0f, -600.0f + rightLift/2, -rightLift/2);
+    setJoint(user.rightPart.foot, XN_SKEL_RIGHT_FOOT, 120.0f, -1000.0f + rightLift, -rightLift);
+
+    camInfo->trackedUsers[0] = user.id;
+    camInfo->trackedUsersCount = 1;
+}
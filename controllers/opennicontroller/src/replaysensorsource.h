@@ -0,0 +1,102 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPLAYSENSORSOURCE_H
+#define REPLAYSENSORSOURCE_H
+
+#include <QCoreApplication>
+#include <QString>
+
+#include <memory>
+
+#include "sensorsource.h"
+#include "sessionreader.h"
+
+// Frequency of the synthetic frames (in frames per second)
+#define SYNTHETIC_FRAME_FREQUENCY 30
+// Depth of the background in the synthetic depth maps (in mm)
+#define SYNTHETIC_BACKGROUND_DEPTH 4000
+
+// Frames read from a session recorded by SessionRecorder, or generated
+// (a single user walking in place while slowly turning) if no file is given.
+//
+// The frames are delivered according to their timestamps divided by the speed:
+// 1 is real time, 2 twice as fast, ... If the speed is 0 or less, a new frame
+// is always available (as fast as possible).
+class ReplaySensorSource: public SensorSource
+{
+        Q_DECLARE_TR_FUNCTIONS(ReplaySensorSource)
+
+    public:
+        ReplaySensorSource(const QString& path, const double speed, const bool loop);
+
+        XnStatus init();
+        XnStatus start();
+        void release();
+
+        bool waitForNewFrame(const int timeout);
+        bool update();
+        bool isUserDataNew() const;
+
+        uint32_t frameID() const;
+        int64_t timestamp() const;
+        const XnDepthPixel *depthMap() const;
+        int depthWidth() const;
+        int depthHeight() const;
+
+        int trackedUsers(XnUserID *ids, const int maxCount);
+        void extractUser(const XnUserID userID, OpenNIUtil::User *user);
+
+    private:
+        uint64_t framesCount() const;
+        // Read a frame of the session (or generate it) without the loop offsets
+        void readFrame(const uint64_t index, OpenNIUtil::CameraInformations *camInfo, const XnDepthPixel **depthMap);
+        void generateFrame(const uint64_t index, OpenNIUtil::CameraInformations *camInfo);
+        // Load the next frame to deliver, return false at the end of the session
+        bool loadNext();
+
+        QString _path;
+        double _speed;
+        bool _loop;
+
+        SessionReader _reader;
+        // False if the depth maps of the session are too large
+        bool _depthSupported = true;
+        // Used for the synthetic frames
+        std::unique_ptr<XnDepthPixel[]> _syntheticDepth;
+
+        // Next frame to deliver
+        uint64_t _nextIndex = 0;
+        bool _hasNext = false;
+        OpenNIUtil::CameraInformations _next;
+        const XnDepthPixel *_nextDepth = nullptr;
+
+        // Current frame
+        OpenNIUtil::CameraInformations _current;
+        const XnDepthPixel *_currentDepth = nullptr;
+
+        // Added to the recorded values so they keep increasing when the session is looped
+        int64_t _timestampOffset = 0;
+        uint32_t _frameIDOffset = 0;
+
+        // Timestamp of the first frame and host time when it was delivered (in µs)
+        int64_t _firstTimestamp = 0;
+        int64_t _startTime = 0;
+};
+
+#endif // REPLAYSENSORSOURCE_H
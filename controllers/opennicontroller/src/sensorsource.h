@@ -0,0 +1,82 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SENSORSOURCE_H
+#define SENSORSOURCE_H
+
+#include <ni/XnTypes.h>
+#include <cstdint>
+
+#include "openniutil.h"
+#include "usbcontroller.h"
+
+// Source of the frames processed by OpenNIApplication.
+// All functions except the motor ones are called from the acquisition thread of OpenNIApplication.
+//
+// Usage:
+// - init() then start()
+// - each time waitForNewFrame() returns true, call update() and read the frame
+//   (unless isUserDataNew() returns false)
+// - release() when done
+class SensorSource
+{
+    public:
+        virtual ~SensorSource() {}
+
+        // Create the generators (or open the files)
+        // Can be called again after release() to re-initialize the source
+        virtual XnStatus init() = 0;
+        // Start generating frames
+        virtual XnStatus start() = 0;
+        // Release all resources, can be called multiple times
+        virtual void release() = 0;
+
+        // Block until a new frame is available, or at most timeout ms
+        // Return false if there is still no new frame
+        virtual bool waitForNewFrame(const int timeout) = 0;
+        // Make the next frame the current one
+        // Return false if the source can't produce frames anymore (end of a replay)
+        virtual bool update() = 0;
+
+        // Check if the skeletons were updated by the last update()
+        // If not, the frame has nothing new to compute and is skipped
+        virtual bool isUserDataNew() const = 0;
+
+        // Frame ID and timestamp (in µs) given by the sensor for the current frame
+        virtual uint32_t frameID() const = 0;
+        virtual int64_t timestamp() const = 0;
+        // Depth map of the current frame (depthWidth() x depthHeight() values, in mm)
+        // Return nullptr if the frame has no depth map
+        virtual const XnDepthPixel *depthMap() const = 0;
+        // Size of the depth maps, known after init()
+        // Never larger than MAX_DEPTH_MAP_LENGTH
+        virtual int depthWidth() const = 0;
+        virtual int depthHeight() const = 0;
+
+        // Fill the IDs of the users with a tracked skeleton in the current frame
+        // Return the number of users
+        virtual int trackedUsers(XnUserID *ids, const int maxCount) = 0;
+        // Fill the joints of a tracked user
+        virtual void extractUser(const XnUserID userID, OpenNIUtil::User *user) = 0;
+
+        // Only available on real sensors, can be called from any thread
+        virtual void moveToAngle(const int /*angle*/) {}
+        virtual void setLight(const USBController::LightType /*type*/) {}
+};
+
+#endif // SENSORSOURCE_H
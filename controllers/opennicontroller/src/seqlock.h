@@ -0,0 +1,90 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Single-producer / multi-consumer container for the latest value of T.
+// The writer never waits: it bumps the sequence to an odd number, copies the value
+// and bumps it again. Readers copy the value and retry if the sequence changed meanwhile,
+// so a slow reader can never stall the writer.
+// T must be trivially copyable since readers may copy a value being written (and discard it).
+template<typename T>
+class SeqLock
+{
+        static_assert(std::is_trivially_copyable<T>::value, "SeqLock only supports trivially copyable types");
+
+        static constexpr std::size_t CacheLineSize = 64;
+
+    public:
+        SeqLock() : _data() {}
+
+        // Must only be called from one thread at a time
+        void store(const T& value)
+        {
+            const uint32_t seq = _seq.load(std::memory_order_relaxed);
+            _seq.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            std::memcpy(static_cast<void*>(&_data), &value, sizeof(T));
+
+            _seq.store(seq + 2, std::memory_order_release);
+        }
+
+        // Can be called from any thread
+        T load() const
+        {
+            T value;
+            uint32_t seqBefore;
+            uint32_t seqAfter;
+            do
+            {
+                seqBefore = _seq.load(std::memory_order_acquire);
+                std::memcpy(static_cast<void*>(&value), &_data, sizeof(T));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                seqAfter = _seq.load(std::memory_order_relaxed);
+            }
+            while((seqBefore & 1) != 0 || seqBefore != seqAfter);
+
+            return value;
+        }
+
+        // Return the number of values stored since the creation
+        uint32_t count() const
+        {
+            return _seq.load(std::memory_order_acquire) / 2;
+        }
+
+    private:
+        // Keep the sequence and the data away from other members to avoid false sharing.
+        // Explicit padding rather than alignas(64): the owners are allocated with plain new,
+        // which does not honour extended alignments before C++17.
+        char _padding0[CacheLineSize];
+        std::atomic<uint32_t> _seq{0};
+        char _padding1[CacheLineSize - sizeof(std::atomic<uint32_t>)];
+        T _data;
+        char _padding2[CacheLineSize];
+};
+
+#endif // SEQLOCK_H
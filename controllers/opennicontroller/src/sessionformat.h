@@ -0,0 +1,88 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SESSIONFORMAT_H
+#define SESSIONFORMAT_H
+
+#include <cstdint>
+
+#include "openniutil.h"
+
+// Binary format of the recorded sessions (native endianness).
+//
+// File layout:
+//   SessionFileHeader
+//   SessionRecordHeader + CameraInformations [+ depth map]   (repeated)
+//   uint64_t offsets[count]                                   (offset of each record)
+//   SessionIndexFooter
+//
+// The index and the footer are only written when the recording is stopped.
+// If they are missing (crash during a recording), the records can still be
+// found by scanning the file from the header.
+namespace SessionFormat
+{
+    const uint32_t FILE_MAGIC = 0x53435256;   // "VRCS"
+    const uint32_t RECORD_MAGIC = 0x4d415246; // "FRAM"
+    const uint32_t INDEX_MAGIC = 0x58444e49;  // "INDX"
+
+    // Must be changed each time the layout or CameraInformations change
+    const uint32_t VERSION = 2;
+
+    enum RecordFlags
+    {
+        RECORD_HAS_DEPTH = 1 << 0
+    };
+
+    struct SessionFileHeader
+    {
+        uint32_t magic = FILE_MAGIC;
+        uint32_t version = VERSION;
+        // Used to reject files written by an incompatible build
+        uint32_t camInfoSize = sizeof(OpenNIUtil::CameraInformations);
+        uint32_t depthWidth = 0;
+        uint32_t depthHeight = 0;
+        uint32_t reserved = 0;
+    };
+
+    struct SessionRecordHeader
+    {
+        uint32_t magic = RECORD_MAGIC;
+        uint32_t flags = 0;
+        // Size of the whole record, this header and the padding included
+        uint64_t size = 0;
+    };
+
+    struct SessionIndexFooter
+    {
+        uint64_t indexOffset = 0;
+        uint64_t count = 0;
+        uint32_t magic = INDEX_MAGIC;
+        uint32_t reserved = 0;
+    };
+
+    inline uint64_t recordSize(const uint32_t flags, const uint32_t depthWidth, const uint32_t depthHeight)
+    {
+        uint64_t size = sizeof(SessionRecordHeader) + sizeof(OpenNIUtil::CameraInformations);
+        if(flags & RECORD_HAS_DEPTH)
+            size += uint64_t(depthWidth) * depthHeight * sizeof(XnDepthPixel);
+        // Keep the records aligned on 8 bytes
+        return (size + 7) & ~uint64_t(7);
+    }
+}
+
+#endif // SESSIONFORMAT_H
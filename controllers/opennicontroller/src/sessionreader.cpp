@@ -0,0 +1,196 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sessionreader.h"
+
+#include <QDebug>
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace SessionFormat;
+
+SessionReader::SessionReader()
+{
+}
+
+SessionReader::~SessionReader()
+{
+    close();
+}
+
+bool SessionReader::open(const QString& path)
+{
+    close();
+    _path = path;
+
+    const int fd = ::open(path.toLocal8Bit().constData(), O_RDONLY);
+    if(fd == -1)
+    {
+        qCritical() << qPrintable(tr("Can't open the session file %1: %2").arg(path, std::strerror(errno)));
+        return false;
+    }
+
+    struct stat fileStat;
+    if(fstat(fd, &fileStat) != 0 || uint64_t(fileStat.st_size) < sizeof(SessionFileHeader))
+    {
+        qCritical() << qPrintable(tr("The session file %1 is too small.").arg(path));
+        ::close(fd);
+        return false;
+    }
+
+    void *map = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping stays valid after the file is closed
+    ::close(fd);
+    if(map == MAP_FAILED)
+    {
+        qCritical() << qPrintable(tr("Can't map the session file %1: %2").arg(path, std::strerror(errno)));
+        return false;
+    }
+
+    _map = static_cast<const uint8_t*>(map);
+    _size = fileStat.st_size;
+
+    std::memcpy(&_header, _map, sizeof(_header));
+    if(_header.magic != FILE_MAGIC || _header.version != VERSION
+       || _header.camInfoSize != sizeof(OpenNIUtil::CameraInformations))
+    {
+        qCritical() << qPrintable(tr("The session file %1 is not supported by this version.").arg(path));
+        close();
+        return false;
+    }
+
+    _indexed = loadIndex();
+    if(!_indexed)
+    {
+        qWarning() << qPrintable(tr("The session file %1 has no index, the recording was probably interrupted.").arg(path));
+        scanRecords();
+    }
+
+    qDebug() << qPrintable(tr("Session %1 opened: %2 frames.").arg(path).arg(_index.size()));
+    return true;
+}
+
+void SessionReader::close()
+{
+    if(_map != nullptr)
+        munmap(const_cast<uint8_t*>(_map), _size);
+    _map = nullptr;
+    _size = 0;
+    _indexed = false;
+    _index.clear();
+}
+
+bool SessionReader::isOpen() const
+{
+    return _map != nullptr;
+}
+
+bool SessionReader::isIndexed() const
+{
+    return _indexed;
+}
+
+uint64_t SessionReader::frameCount() const
+{
+    return _index.size();
+}
+
+uint32_t SessionReader::depthWidth() const
+{
+    return _header.depthWidth;
+}
+
+uint32_t SessionReader::depthHeight() const
+{
+    return _header.depthHeight;
+}
+
+bool SessionReader::readFrame(const uint64_t index, OpenNIUtil::CameraInformations *camInfo, const XnDepthPixel **depthMap) const
+{
+    if(index >= _index.size())
+        return false;
+
+    const uint64_t offset = _index[index];
+    SessionRecordHeader header;
+    std::memcpy(&header, _map + offset, sizeof(header));
+
+    std::memcpy(camInfo, _map + offset + sizeof(header), sizeof(OpenNIUtil::CameraInformations));
+    if(depthMap != nullptr)
+    {
+        if(header.flags & RECORD_HAS_DEPTH)
+            *depthMap = reinterpret_cast<const XnDepthPixel*>(_map + offset + sizeof(header) + sizeof(OpenNIUtil::CameraInformations));
+        else
+            *depthMap = nullptr;
+    }
+    return true;
+}
+
+// Private
+bool SessionReader::loadIndex()
+{
+    if(_size < sizeof(SessionFileHeader) + sizeof(SessionIndexFooter))
+        return false;
+
+    SessionIndexFooter footer;
+    std::memcpy(&footer, _map + _size - sizeof(footer), sizeof(footer));
+    if(footer.magic != INDEX_MAGIC || footer.indexOffset < sizeof(SessionFileHeader)
+       || footer.count > (_size - footer.indexOffset) / sizeof(uint64_t)
+       || footer.indexOffset + footer.count * sizeof(uint64_t) + sizeof(footer) != _size)
+        return false;
+
+    _index.resize(footer.count);
+    if(footer.count > 0)
+        std::memcpy(_index.data(), _map + footer.indexOffset, footer.count * sizeof(uint64_t));
+
+    // Check all records once, so readFrame() can trust the offsets
+    for(const uint64_t offset : _index)
+    {
+        SessionRecordHeader header;
+        if(offset < sizeof(SessionFileHeader) || offset + sizeof(header) > footer.indexOffset)
+            return false;
+        std::memcpy(&header, _map + offset, sizeof(header));
+        if(header.magic != RECORD_MAGIC || header.size != recordSize(header.flags, _header.depthWidth, _header.depthHeight)
+           || offset + header.size > footer.indexOffset)
+            return false;
+    }
+    return true;
+}
+
+void SessionReader::scanRecords()
+{
+    _index.clear();
+
+    uint64_t offset = sizeof(SessionFileHeader);
+    while(offset + sizeof(SessionRecordHeader) <= _size)
+    {
+        SessionRecordHeader header;
+        std::memcpy(&header, _map + offset, sizeof(header));
+        // Stop at the first incomplete record
+        if(header.magic != RECORD_MAGIC || header.size != recordSize(header.flags, _header.depthWidth, _header.depthHeight)
+           || offset + header.size > _size)
+            break;
+
+        _index.push_back(offset);
+        offset += header.size;
+    }
+}
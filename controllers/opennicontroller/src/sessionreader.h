@@ -0,0 +1,73 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SESSIONREADER_H
+#define SESSIONREADER_H
+
+#include <QCoreApplication>
+#include <QString>
+
+#include <cstdint>
+#include <vector>
+
+#include "openniutil.h"
+#include "sessionformat.h"
+
+// Read a session written by SessionRecorder.
+// The file is memory-mapped and any frame can be read in constant time.
+class SessionReader
+{
+        Q_DECLARE_TR_FUNCTIONS(SessionReader)
+
+    public:
+        SessionReader();
+        ~SessionReader();
+
+        SessionReader(const SessionReader&) = delete;
+        SessionReader& operator=(const SessionReader&) = delete;
+
+        bool open(const QString& path);
+        void close();
+
+        bool isOpen() const;
+        // False if the index was missing and the records were found by scanning the file
+        bool isIndexed() const;
+
+        uint64_t frameCount() const;
+        uint32_t depthWidth() const;
+        uint32_t depthHeight() const;
+
+        // Read the frame at the specified index
+        // depthMap is set to nullptr if the frame has no depth map, otherwise it points
+        // in the mapped file and stays valid until the reader is closed
+        bool readFrame(const uint64_t index, OpenNIUtil::CameraInformations *camInfo, const XnDepthPixel **depthMap = nullptr) const;
+
+    private:
+        bool loadIndex();
+        void scanRecords();
+
+        QString _path;
+        const uint8_t *_map = nullptr;
+        uint64_t _size = 0;
+        bool _indexed = false;
+
+        SessionFormat::SessionFileHeader _header;
+        std::vector<uint64_t> _index;
+};
+
+#endif // SESSIONREADER_H
@@ -0,0 +1,282 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sessionrecorder.h"
+
+#include <QDebug>
+
+#include <cerrno>
+#include <cstring>
+#include <chrono>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace SessionFormat;
+
+SessionRecorder::SessionRecorder()
+{
+}
+
+SessionRecorder::~SessionRecorder()
+{
+    stop();
+}
+
+bool SessionRecorder::start(const QString& path, const bool withDepth, const int depthWidth, const int depthHeight)
+{
+    if(_recording)
+    {
+        qCritical() << qPrintable(tr("A session is already being recorded !"));
+        return false;
+    }
+
+    _fd = ::open(path.toLocal8Bit().constData(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(_fd == -1)
+    {
+        qCritical() << qPrintable(tr("Can't create the session file %1: %2").arg(path, std::strerror(errno)));
+        return false;
+    }
+
+    _path = path;
+    _withDepth = withDepth;
+    _depthWidth = depthWidth;
+    _depthHeight = depthHeight;
+    _map = nullptr;
+    _mappedSize = 0;
+    _offset = 0;
+    _writeError = false;
+    _index.clear();
+    _recordedFrames = 0;
+    _droppedFrames = 0;
+    _framesWithoutDepth = 0;
+
+    SessionFileHeader header;
+    header.depthWidth = _depthWidth;
+    header.depthHeight = _depthHeight;
+    if(!reserve(sizeof(header)))
+    {
+        _writeError = true;
+        finish();
+        return false;
+    }
+    std::memcpy(_map, &header, sizeof(header));
+    _offset = sizeof(header);
+
+    qDebug() << qPrintable(tr("Recording the session in %1 ...").arg(path));
+
+    _writerRunning = true;
+    _writer = std::thread(&SessionRecorder::writerLoop, this);
+    _recording = true;
+    return true;
+}
+
+void SessionRecorder::stop()
+{
+    if(!_recording.exchange(false))
+        return;
+
+    // Wait for the end of a record() call started before the flag was cleared
+    while(_activeProducers.load() > 0)
+        std::this_thread::yield();
+
+    _writerRunning = false;
+    _writer.join();
+
+    qDebug() << qPrintable(tr("Session recorded in %1: %2 frames, %3 dropped, %4 without depth map.")
+                           .arg(_path).arg(_recordedFrames.load()).arg(_droppedFrames.load()).arg(_framesWithoutDepth.load()));
+}
+
+bool SessionRecorder::isRecording() const
+{
+    return _recording;
+}
+
+void SessionRecorder::record(const OpenNIUtil::CameraInformations& camInfo, const DepthFrame& depthFrame)
+{
+    _activeProducers.fetch_add(1);
+    if(_recording.load())
+    {
+        Entry entry;
+        entry.camInfo = camInfo;
+
+        if(_withDepth)
+        {
+            // The size may change if the sensor is plugged again during the recording
+            if(!depthFrame.isNull() && depthFrame.width() == _depthWidth && depthFrame.height() == _depthHeight
+               && _depthFramesInQueue.load(std::memory_order_relaxed) < SESSION_MAX_DEPTH_FRAMES)
+            {
+                entry.depthFrame = depthFrame;
+                _depthFramesInQueue.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+                _framesWithoutDepth.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // On failure, the entry (and its depth frame) is released here
+        if(!_queue.push(std::move(entry)))
+        {
+            if(!entry.depthFrame.isNull())
+                _depthFramesInQueue.fetch_sub(1, std::memory_order_relaxed);
+            _droppedFrames.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    _activeProducers.fetch_sub(1);
+}
+
+uint64_t SessionRecorder::recordedFrames() const
+{
+    return _recordedFrames;
+}
+
+uint64_t SessionRecorder::droppedFrames() const
+{
+    return _droppedFrames;
+}
+
+uint64_t SessionRecorder::framesWithoutDepth() const
+{
+    return _framesWithoutDepth;
+}
+
+// Private
+void SessionRecorder::writerLoop()
+{
+    Entry entry;
+    while(true)
+    {
+        // Read the flag before draining, so nothing pushed before the stop is missed
+        const bool running = _writerRunning.load();
+
+        while(_queue.pop(entry))
+        {
+            write(entry);
+            if(!entry.depthFrame.isNull())
+            {
+                entry.depthFrame = DepthFrame();
+                _depthFramesInQueue.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+
+        if(!running)
+            break;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(SESSION_WRITER_POLL_INTERVAL));
+    }
+
+    finish();
+}
+
+void SessionRecorder::write(const Entry& entry)
+{
+    if(_writeError)
+        return;
+
+    SessionRecordHeader header;
+    if(!entry.depthFrame.isNull())
+        header.flags |= RECORD_HAS_DEPTH;
+    header.size = recordSize(header.flags, _depthWidth, _depthHeight);
+
+    if(!reserve(header.size))
+    {
+        _writeError = true;
+        return;
+    }
+
+    uint8_t *record = _map + _offset;
+    std::memset(record, 0, header.size);
+    std::memcpy(record, &header, sizeof(header));
+    std::memcpy(record + sizeof(header), &entry.camInfo, sizeof(entry.camInfo));
+    if(header.flags & RECORD_HAS_DEPTH)
+        std::memcpy(record + sizeof(header) + sizeof(entry.camInfo), entry.depthFrame.data(), _depthWidth * _depthHeight * sizeof(XnDepthPixel));
+
+    _index.push_back(_offset);
+    _offset += header.size;
+    _recordedFrames.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool SessionRecorder::reserve(const uint64_t size)
+{
+    if(_offset + size <= _mappedSize)
+        return true;
+
+    uint64_t newSize = _mappedSize + SESSION_FILE_CHUNK_SIZE;
+    if(newSize < _offset + size)
+        newSize = _offset + size;
+
+    if(_map != nullptr)
+    {
+        munmap(_map, _mappedSize);
+        _map = nullptr;
+    }
+
+    // Allocate the blocks now: writing in a sparse mapping would crash if the disk is full
+    const int error = posix_fallocate(_fd, _mappedSize, newSize - _mappedSize);
+    if(error != 0)
+    {
+        qCritical() << qPrintable(tr("Can't extend the session file %1: %2").arg(_path, std::strerror(error)));
+        _mappedSize = 0;
+        return false;
+    }
+
+    void *map = mmap(nullptr, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if(map == MAP_FAILED)
+    {
+        qCritical() << qPrintable(tr("Can't map the session file %1: %2").arg(_path, std::strerror(errno)));
+        _mappedSize = 0;
+        return false;
+    }
+
+    _map = static_cast<uint8_t*>(map);
+    _mappedSize = newSize;
+    return true;
+}
+
+void SessionRecorder::finish()
+{
+    if(_fd == -1)
+        return;
+
+    if(!_writeError)
+    {
+        SessionIndexFooter footer;
+        footer.indexOffset = _offset;
+        footer.count = _index.size();
+
+        const uint64_t indexSize = _index.size() * sizeof(uint64_t);
+        if(reserve(indexSize + sizeof(footer)))
+        {
+            if(indexSize > 0)
+                std::memcpy(_map + _offset, _index.data(), indexSize);
+            std::memcpy(_map + _offset + indexSize, &footer, sizeof(footer));
+            _offset += indexSize + sizeof(footer);
+        }
+    }
+
+    if(_map != nullptr)
+        munmap(_map, _mappedSize);
+
+    // Remove the unused part of the last chunk
+    if(ftruncate(_fd, _offset) != 0)
+        qCritical() << qPrintable(tr("Can't truncate the session file %1: %2").arg(_path, std::strerror(errno)));
+    ::close(_fd);
+
+    _fd = -1;
+    _map = nullptr;
+    _mappedSize = 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SESSIONRECORDER_H
+#define SESSIONRECORDER_H
+
+#include <QCoreApplication>
+#include <QString>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "openniutil.h"
+#include "depthframepool.h"
+#include "sessionformat.h"
+#include "spscqueue.h"
+
+// Number of frames buffered between the frame pipeline and the writer thread
+#define SESSION_QUEUE_CAPACITY 256
+// Maximum number of depth frames held by the recorder at the same time
+// (these frames are taken from the depth frame pool)
+#define SESSION_MAX_DEPTH_FRAMES 4
+// The file grows by chunks of this size (in bytes)
+#define SESSION_FILE_CHUNK_SIZE (64 * 1024 * 1024)
+// Interval between two checks of the queue in the writer thread (in ms)
+#define SESSION_WRITER_POLL_INTERVAL 5
+
+// Record the camera informations (and optionally the depth maps) in a memory-mapped file.
+// See sessionformat.h for the layout of the file.
+//
+// record() is called from the frame pipeline and never blocks: the frames are pushed in a
+// lock-free queue and written by a dedicated thread. If the queue is full, the frame is dropped.
+// start() and stop() must be called from the same thread.
+class SessionRecorder
+{
+        Q_DECLARE_TR_FUNCTIONS(SessionRecorder)
+
+    public:
+        SessionRecorder();
+        ~SessionRecorder();
+
+        SessionRecorder(const SessionRecorder&) = delete;
+        SessionRecorder& operator=(const SessionRecorder&) = delete;
+
+        // Create the file (overwritten if it exists) and start the writer thread
+        // Only the depth maps of the given size are recorded
+        bool start(const QString& path, const bool withDepth, const int depthWidth, const int depthHeight);
+        // Write all pending frames, the index, and close the file
+        void stop();
+
+        bool isRecording() const;
+
+        // Must only be called from one thread (the publication stage of the pipeline)
+        // The depth frame is kept until written, it may be omitted if too many are held
+        void record(const OpenNIUtil::CameraInformations& camInfo, const DepthFrame& depthFrame);
+
+        uint64_t recordedFrames() const;
+        // Frames lost because the queue was full
+        uint64_t droppedFrames() const;
+        // Frames recorded without their depth map
+        uint64_t framesWithoutDepth() const;
+
+    private:
+        struct Entry
+        {
+            OpenNIUtil::CameraInformations camInfo;
+            DepthFrame depthFrame;
+        };
+
+        void writerLoop();
+        void write(const Entry& entry);
+        // Grow the mapping so that size bytes can be written at the current offset
+        bool reserve(const uint64_t size);
+        // Write the index and close the file
+        void finish();
+
+        SPSCQueue<Entry, SESSION_QUEUE_CAPACITY> _queue;
+
+        std::atomic<bool> _recording{false};
+        // Number of record() calls in progress, used to stop safely
+        std::atomic<int> _activeProducers{0};
+        std::atomic<bool> _writerRunning{false};
+        std::atomic<int> _depthFramesInQueue{0};
+        bool _withDepth = false;
+        int _depthWidth = 0;
+        int _depthHeight = 0;
+
+        std::atomic<uint64_t> _recordedFrames{0};
+        std::atomic<uint64_t> _droppedFrames{0};
+        std::atomic<uint64_t> _framesWithoutDepth{0};
+
+        std::thread _writer;
+
+        // Only used by the writer thread while recording
+        QString _path;
+        int _fd = -1;
+        uint8_t *_map = nullptr;
+        uint64_t _mappedSize = 0;
+        uint64_t _offset = 0;
+        bool _writeError = false;
+        std::vector<uint64_t> _index;
+};
+
+#endif // SESSIONRECORDER_H
@@ -0,0 +1,90 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// Bounded single-producer / single-consumer queue.
+// push() and pop() never block nor allocate: push() fails when the queue is full
+// and pop() fails when it is empty. Capacity must be a power of two.
+template<typename T, uint32_t Capacity>
+class SPSCQueue
+{
+        static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "The capacity must be a power of two");
+
+        static constexpr std::size_t CacheLineSize = 64;
+
+    public:
+        SPSCQueue() {}
+
+        SPSCQueue(const SPSCQueue&) = delete;
+        SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+        // Only called by the producer
+        bool push(T&& value)
+        {
+            const uint32_t tail = _tail.load(std::memory_order_relaxed);
+            if(tail - _head.load(std::memory_order_acquire) == Capacity)
+                return false;
+
+            _items[tail & (Capacity - 1)] = std::move(value);
+            _tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Only called by the consumer
+        bool pop(T& value)
+        {
+            const uint32_t head = _head.load(std::memory_order_relaxed);
+            if(head == _tail.load(std::memory_order_acquire))
+                return false;
+
+            value = std::move(_items[head & (Capacity - 1)]);
+            _head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Approximative when called while the queue is used
+        uint32_t size() const
+        {
+            return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+        }
+
+        bool isEmpty() const
+        {
+            return size() == 0;
+        }
+
+    private:
+        // Indexes only grow, they are wrapped when accessing the items
+        // The padding keeps the producer and the consumer indexes on separate cache lines
+        char _padding0[CacheLineSize];
+        std::atomic<uint32_t> _head{0};
+        char _padding1[CacheLineSize - sizeof(std::atomic<uint32_t>)];
+        std::atomic<uint32_t> _tail{0};
+        char _padding2[CacheLineSize - sizeof(std::atomic<uint32_t>)];
+        T _items[Capacity];
+        char _padding3[CacheLineSize];
+};
+
+#endif // SPSCQUEUE_H
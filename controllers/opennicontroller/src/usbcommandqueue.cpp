@@ -0,0 +1,122 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "usbcommandqueue.h"
+
+USBCommandQueue::USBCommandQueue(USBController *controller): _controller(controller)
+{
+    _thread = std::thread(&USBCommandQueue::run, this);
+}
+
+USBCommandQueue::~USBCommandQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _condition.notify_one();
+    _thread.join();
+}
+
+void USBCommandQueue::moveToAngle(const int angle, Callback callback)
+{
+    post(MotorCommand, angle, callback);
+}
+
+void USBCommandQueue::setLight(const USBController::LightType type, Callback callback)
+{
+    post(LightCommand, static_cast<int>(type), callback);
+}
+
+uint64_t USBCommandQueue::coalescedCommands() const
+{
+    return _coalescedCommands.load(std::memory_order_relaxed);
+}
+
+// Private
+void USBCommandQueue::post(const CommandType type, const int value, Callback callback)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Mailbox& mailbox = _mailboxes[type];
+        if(mailbox.pending)
+            _coalescedCommands.fetch_add(1, std::memory_order_relaxed);
+        mailbox.pending = true;
+        mailbox.value = value;
+        if(callback)
+            mailbox.callbacks.push_back(callback);
+    }
+    _condition.notify_one();
+}
+
+void USBCommandQueue::run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while(true)
+    {
+        _condition.wait(lock, [this]() {
+            if(_stopping)
+                return true;
+            for(const Mailbox& mailbox : _mailboxes)
+            {
+                if(mailbox.pending)
+                    return true;
+            }
+            return false;
+        });
+
+        bool sent = false;
+        for(int type=0; type < CommandsCount; ++type)
+        {
+            Mailbox& mailbox = _mailboxes[type];
+            if(!mailbox.pending)
+                continue;
+
+            const int value = mailbox.value;
+            std::vector<Callback> callbacks;
+            callbacks.swap(mailbox.callbacks);
+            mailbox.pending = false;
+
+            // New commands can be posted during the transfer
+            lock.unlock();
+            const XnStatus status = send(static_cast<CommandType>(type), value);
+            for(const Callback& callback : callbacks)
+                callback(status);
+            lock.lock();
+
+            sent = true;
+        }
+
+        // Only stop once all mailboxes are empty
+        if(_stopping && !sent)
+            break;
+    }
+}
+
+XnStatus USBCommandQueue::send(const CommandType type, const int value)
+{
+    switch(type)
+    {
+        case MotorCommand:
+            return _controller->moveToAngle(value);
+        case LightCommand:
+            return _controller->setLight(static_cast<USBController::LightType>(value));
+        default:
+            return 1;
+    }
+}
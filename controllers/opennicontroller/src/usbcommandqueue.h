@@ -0,0 +1,93 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef USBCOMMANDQUEUE_H
+#define USBCOMMANDQUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "usbcontroller.h"
+
+// Send the commands of a USBController in a dedicated thread.
+// There is one mailbox per command type, holding only the latest value:
+// if a command is posted before the previous one of the same type is sent,
+// only the newest value is sent (for example when the motor spin box is dragged).
+//
+// Posting a command never waits for a USB transfer. The callbacks are called
+// from the USB thread with the status of the transfer that completed the command
+// (so a replaced command gets the status of the one that replaced it).
+class USBCommandQueue
+{
+    public:
+        typedef std::function<void(XnStatus)> Callback;
+
+        // The controller must be initialized and outlive the queue
+        // It is then only used from the USB thread
+        explicit USBCommandQueue(USBController *controller);
+        // Send the pending commands and stop the thread
+        ~USBCommandQueue();
+
+        USBCommandQueue(const USBCommandQueue&) = delete;
+        USBCommandQueue& operator=(const USBCommandQueue&) = delete;
+
+        // Can be called from any thread
+        void moveToAngle(const int angle, Callback callback = Callback());
+        void setLight(const USBController::LightType type, Callback callback = Callback());
+
+        // Number of commands replaced by a newer one before being sent
+        uint64_t coalescedCommands() const;
+
+    private:
+        enum CommandType
+        {
+            MotorCommand = 0,
+            LightCommand,
+
+            CommandsCount
+        };
+
+        struct Mailbox
+        {
+            bool pending = false;
+            int value = 0;
+            std::vector<Callback> callbacks;
+        };
+
+        void post(const CommandType type, const int value, Callback callback);
+        void run();
+        XnStatus send(const CommandType type, const int value);
+
+        USBController *_controller;
+
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        Mailbox _mailboxes[CommandsCount];
+        bool _stopping = false;
+
+        std::atomic<uint64_t> _coalescedCommands{0};
+
+        std::thread _thread;
+};
+
+#endif // USBCOMMANDQUEUE_H
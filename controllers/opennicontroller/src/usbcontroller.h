@@ -31,6 +31,7 @@
 #include <QObject>
 #include <QDebug>
 #include <QString>
+#include <QMetaType>
 
 #define KINECT_VENDOR_ID 0x045e
 #define KINECT_MOTOR_PRODUCT_ID 0x02b0
@@ -53,8 +54,15 @@ struct USBDevicePath
                 .arg(bus, 0, 10)
                 .arg(device, 0, 10);
     }
+
+    bool operator==(const USBDevicePath& other) const
+    {
+        return vendor == other.vendor && product == other.product && bus == other.bus && device == other.device;
+    }
 };
 
+Q_DECLARE_METATYPE(USBDevicePath)
+
 // Generic class used to send data in the USB port.
 class USBController: public QObject
 {
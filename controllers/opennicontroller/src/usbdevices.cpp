@@ -0,0 +1,207 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "usbdevices.h"
+
+#include <QDir>
+#include <QFile>
+#include <QSocketNotifier>
+#include <QStringList>
+#include <QDebug>
+
+#include <cerrno>
+#include <cstring>
+#include <linux/netlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define SYSFS_USB_DEVICES_PATH QStringLiteral("/sys/bus/usb/devices")
+// Kernel uevents (not the ones sent again by udev)
+#define UEVENT_KERNEL_GROUP 1
+#define UEVENT_BUFFER_SIZE 4096
+
+// Read a sysfs attribute of a device
+static QString readAttribute(const QString& devicePath, const QString& name)
+{
+    QFile file(devicePath + QStringLiteral("/") + name);
+    if(!file.open(QIODevice::ReadOnly))
+        return QString();
+    return QString::fromLatin1(file.readAll()).trimmed();
+}
+
+// The port of the hub the device is connected to ("1-1.2" -> "1-1")
+static QString parentPort(const QString& port)
+{
+    const int separator = port.lastIndexOf('.');
+    return separator == -1 ? QString() : port.left(separator);
+}
+
+QList<USBDevices::Device> USBDevices::devices(const int vendor)
+{
+    QList<Device> list;
+
+    const QDir dir(SYSFS_USB_DEVICES_PATH);
+    for(const QString& port : dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot))
+    {
+        // Interfaces contain a ':', root hubs start with "usb"
+        if(port.contains(':') || port.startsWith(QStringLiteral("usb")))
+            continue;
+
+        const QString devicePath = dir.filePath(port);
+        bool ok = false;
+        const int deviceVendor = readAttribute(devicePath, QStringLiteral("idVendor")).toInt(&ok, 16);
+        if(!ok || deviceVendor != vendor)
+            continue;
+
+        Device device;
+        device.port = port;
+        device.path.vendor = deviceVendor;
+        device.path.product = readAttribute(devicePath, QStringLiteral("idProduct")).toInt(nullptr, 16);
+        device.path.bus = readAttribute(devicePath, QStringLiteral("busnum")).toInt();
+        device.path.device = readAttribute(devicePath, QStringLiteral("devnum")).toInt();
+        list.append(device);
+    }
+
+    return list;
+}
+
+QList<KinectSensor> USBDevices::kinectSensors()
+{
+    QList<Device> cameras;
+    QList<Device> motors;
+    for(const Device& device : devices(KINECT_VENDOR_ID))
+    {
+        if(device.path.product == KINECT_CAMERA_PRODUCT_ID)
+            cameras.append(device);
+        else if(device.path.product == KINECT_MOTOR_PRODUCT_ID)
+            motors.append(device);
+    }
+
+    // Pair the devices behind the same hub
+    QList<KinectSensor> sensors;
+    for(int i=0; i < cameras.size(); ++i)
+    {
+        for(int j=0; j < motors.size(); ++j)
+        {
+            if(!parentPort(cameras[i].port).isEmpty() && parentPort(cameras[i].port) == parentPort(motors[j].port))
+            {
+                sensors.append(KinectSensor({cameras[i].path, motors[j].path}));
+                cameras.removeAt(i--);
+                motors.removeAt(j);
+                break;
+            }
+        }
+    }
+
+    // Unknown topology, only pair when there is no ambiguity
+    if(cameras.size() == 1 && motors.size() == 1)
+        sensors.append(KinectSensor({cameras[0].path, motors[0].path}));
+
+    return sensors;
+}
+
+//
+// USBHotplugMonitor
+//
+
+USBHotplugMonitor::USBHotplugMonitor(QObject *parent): QObject(parent)
+{
+    qRegisterMetaType<USBDevicePath>();
+
+    _socket = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+    if(_socket == -1)
+    {
+        qWarning() << qPrintable(tr("Can't listen to the USB events: %1").arg(std::strerror(errno)));
+        return;
+    }
+
+    sockaddr_nl address;
+    std::memset(&address, 0, sizeof(address));
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = UEVENT_KERNEL_GROUP;
+    if(bind(_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        qWarning() << qPrintable(tr("Can't listen to the USB events: %1").arg(std::strerror(errno)));
+        close(_socket);
+        _socket = -1;
+        return;
+    }
+
+    _notifier = new QSocketNotifier(_socket, QSocketNotifier::Read, this);
+    connect(_notifier, &QSocketNotifier::activated, this, &USBHotplugMonitor::readEvents);
+}
+
+USBHotplugMonitor::~USBHotplugMonitor()
+{
+    delete _notifier;
+    if(_socket != -1)
+        close(_socket);
+}
+
+bool USBHotplugMonitor::isValid() const
+{
+    return _socket != -1;
+}
+
+// Private slot
+void USBHotplugMonitor::readEvents()
+{
+    char buffer[UEVENT_BUFFER_SIZE];
+    while(true)
+    {
+        const ssize_t size = recv(_socket, buffer, sizeof(buffer) - 1, 0);
+        if(size <= 0)
+            break;
+        buffer[size] = '\0';
+
+        // The event is a list of null-terminated strings:
+        // "add@/devices/...", "ACTION=add", "DEVTYPE=usb_device", "PRODUCT=45e/2ae/10c", "BUSNUM=001", ...
+        QString action;
+        QString devType;
+        QString product;
+        int bus = -1;
+        int device = -1;
+        for(ssize_t offset = 0; offset < size; offset += std::strlen(buffer + offset) + 1)
+        {
+            const QString line = QString::fromLatin1(buffer + offset);
+            if(line.startsWith(QStringLiteral("ACTION=")))
+                action = line.mid(7);
+            else if(line.startsWith(QStringLiteral("DEVTYPE=")))
+                devType = line.mid(8);
+            else if(line.startsWith(QStringLiteral("PRODUCT=")))
+                product = line.mid(8);
+            else if(line.startsWith(QStringLiteral("BUSNUM=")))
+                bus = line.mid(7).toInt();
+            else if(line.startsWith(QStringLiteral("DEVNUM=")))
+                device = line.mid(7).toInt();
+        }
+
+        if(devType != QStringLiteral("usb_device"))
+            continue;
+
+        const QStringList productParts = product.split('/');
+        if(productParts.size() < 2 || productParts[0].toInt(nullptr, 16) != KINECT_VENDOR_ID)
+            continue;
+
+        const USBDevicePath path({KINECT_VENDOR_ID, productParts[1].toInt(nullptr, 16), bus, device});
+        if(action == QStringLiteral("add"))
+            emit kinectDeviceAdded(path);
+        else if(action == QStringLiteral("remove"))
+            emit kinectDeviceRemoved(path);
+    }
+}
@@ -0,0 +1,79 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef USBDEVICES_H
+#define USBDEVICES_H
+
+#include <QObject>
+#include <QList>
+#include <QString>
+
+#include "usbcontroller.h"
+
+class QSocketNotifier;
+
+// Devices of one Kinect (they are behind the same internal hub)
+struct KinectSensor
+{
+    USBDevicePath camera;
+    USBDevicePath motor;
+};
+
+// Enumerate the USB devices with the sysfs (no external process is used)
+namespace USBDevices
+{
+    struct Device
+    {
+        USBDevicePath path;
+        // Name of the device in the sysfs (for example "1-1.2"), it represents the USB port
+        QString port;
+    };
+
+    // Return all devices with the specified vendor ID
+    QList<Device> devices(const int vendor);
+
+    // Return all connected Kinects
+    QList<KinectSensor> kinectSensors();
+}
+
+// Listen to the kernel events to detect when a Kinect device is plugged or unplugged.
+// Must be used in a thread with an event loop.
+class USBHotplugMonitor: public QObject
+{
+        Q_OBJECT
+
+    public:
+        explicit USBHotplugMonitor(QObject *parent = nullptr);
+        ~USBHotplugMonitor();
+
+        // Return false if the kernel events can't be read
+        bool isValid() const;
+
+    signals:
+        void kinectDeviceAdded(USBDevicePath path);
+        void kinectDeviceRemoved(USBDevicePath path);
+
+    private slots:
+        void readEvents();
+
+    private:
+        int _socket = -1;
+        QSocketNotifier *_notifier = nullptr;
+};
+
+#endif // USBDEVICES_H
@@ -0,0 +1,276 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "usertable.h"
+
+#include <cmath>
+
+UserTable::UserTable()
+{
+    for(int row=0; row < MAX_TRACKED_USERS; ++row)
+    {
+        _id[row] = 0;
+        _seen[row] = false;
+        _hasPose[row] = false;
+        _hasHistory[row] = false;
+        _updated[row] = false;
+        _timestamp[row] = 0;
+        _previousTimestamp[row] = 0;
+        _rotation[row] = -1;
+        _walkSpeed[row] = -1;
+        _framesWithoutMove[row] = 0;
+        _rawRotation[row] = -1.0f;
+        _rawSpeed[row] = -1.0f;
+    }
+}
+
+void UserTable::clear()
+{
+    // The rows are initialized again by rowForUser()
+    _count = 0;
+}
+
+void UserTable::beginFrame()
+{
+    for(int row=0; row < _count; ++row)
+    {
+        _seen[row] = false;
+        _updated[row] = false;
+    }
+}
+
+int UserTable::rowForUser(const XnUserID id)
+{
+    const int row = rowOf(id);
+    if(row != -1)
+        return row;
+
+    if(_count == MAX_TRACKED_USERS)
+        return -1;
+
+    // New user, without any history
+    const int newRow = _count++;
+    _id[newRow] = id;
+    _seen[newRow] = false;
+    _hasPose[newRow] = false;
+    _hasHistory[newRow] = false;
+    _updated[newRow] = false;
+    _timestamp[newRow] = 0;
+    _rotation[newRow] = -1;
+    _walkSpeed[newRow] = -1;
+    _framesWithoutMove[newRow] = 0;
+    _rotationFilter[newRow].reset();
+    _speedFilter[newRow].reset();
+    _history[newRow].reset();
+    _rawRotation[newRow] = -1.0f;
+    _rawSpeed[newRow] = -1.0f;
+    return newRow;
+}
+
+void UserTable::setPose(const int row, const OpenNIUtil::User& pose)
+{
+    _seen[row] = true;
+
+    // Same sensor frame, the motion can't be computed again
+    if(_hasPose[row] && pose.timestamp == _timestamp[row])
+        return;
+
+    _updated[row] = true;
+    _hasHistory[row] = _hasPose[row];
+    _hasPose[row] = true;
+
+    _previousLeftPart[row] = _leftPart[row];
+    _previousRightPart[row] = _rightPart[row];
+    _previousTimestamp[row] = _timestamp[row];
+
+    _torso[row] = pose.torsoJoint;
+    _leftPart[row] = pose.leftPart;
+    _rightPart[row] = pose.rightPart;
+    _timestamp[row] = pose.timestamp;
+}
+
+void UserTable::endFrame()
+{
+    int row = 0;
+    while(row < _count)
+    {
+        if(_seen[row])
+            ++row;
+        else
+        {
+            // Fill the hole with the last row
+            --_count;
+            if(row != _count)
+                moveRow(_count, row);
+        }
+    }
+}
+
+void UserTable::computeMotion(const FilterSettings& rotationFilter, const FilterSettings& speedFilter,
+                              const int64_t predictionHorizon)
+{
+    for(int row=0; row < _count; ++row)
+    {
+        if(!_updated[row])
+            continue;
+
+        const OpenNIUtil::User user = userAt(row);
+
+        float rotation = -1.0f;
+        const float rawRotation = OpenNIUtil::rotationForUser(user);
+        if(rawRotation == -1.0f)
+            _rotation[row] = -1;
+        else
+        {
+            const int previousRotation = _rotation[row];
+            rotation = _rotationFilter[row].filterAngle(rotationFilter, rawRotation, _timestamp[row]);
+            _rotation[row] = static_cast<int>(rotation);
+            if(previousRotation != -1 && _rawRotation[row] != -1.0f)
+                _rotationStats.add(rawRotation, _rawRotation[row], _rotation[row], previousRotation, true);
+        }
+        _rawRotation[row] = rawRotation;
+
+        float speed = -1.0f;
+
+        // Only compute the walk speed if we have the previous frame
+        if(_hasHistory[row])
+        {
+            const int previousSpeed = _walkSpeed[row];
+            const float rawSpeed = OpenNIUtil::walkSpeedForUser(user, _previousTimestamp[row]);
+            if(rawSpeed == -1.0f)
+                _walkSpeed[row] = -1;
+            else
+            {
+                speed = _speedFilter[row].filter(speedFilter, rawSpeed, _timestamp[row]);
+                _walkSpeed[row] = static_cast<int>(speed);
+                if(previousSpeed != -1 && _rawSpeed[row] != -1.0f)
+                    _speedStats.add(rawSpeed, _rawSpeed[row], _walkSpeed[row], previousSpeed, false);
+            }
+            _rawSpeed[row] = rawSpeed;
+
+            if(previousSpeed != -1 && previousSpeed <= MIN_COMPUTED_WALKSPEED)
+                _framesWithoutMove[row]++;
+            else
+                _framesWithoutMove[row] = 0;
+        }
+
+        // Measure the prediction made from the history
+        const MotionSample* old = _history[row].sampleAt(_timestamp[row] - predictionHorizon);
+        if(old != nullptr)
+        {
+            const int64_t elapsed = _timestamp[row] - old->timestamp;
+            if(rotation != -1.0f && old->rotation != -1.0f)
+            {
+                const float predicted = predictRotation(old->rotation, old->rotationRate, elapsed);
+                _rotationPredictionStats.add(std::abs(OpenNIUtil::angleDifference(predicted, rotation)),
+                                             std::abs(OpenNIUtil::angleDifference(old->rotation, rotation)));
+            }
+            if(speed != -1.0f && old->speed != -1.0f)
+            {
+                const float predicted = predictSpeed(old->speed, old->speedRate, elapsed);
+                _speedPredictionStats.add(std::abs(predicted - speed), std::abs(old->speed - speed));
+            }
+        }
+
+        _history[row].add(_timestamp[row], rotation, speed);
+    }
+}
+
+int UserTable::count() const
+{
+    return _count;
+}
+
+int UserTable::rowOf(const XnUserID id) const
+{
+    for(int row=0; row < _count; ++row)
+    {
+        if(_id[row] == id)
+            return row;
+    }
+    return -1;
+}
+
+XnUserID UserTable::idAt(const int row) const
+{
+    return _id[row];
+}
+
+OpenNIUtil::User UserTable::userAt(const int row) const
+{
+    OpenNIUtil::User user;
+    user.id = _id[row];
+    user.isTracking = true;
+    user.timestamp = _timestamp[row];
+
+    user.torsoJoint = _torso[row];
+    user.leftPart = _leftPart[row];
+    user.rightPart = _rightPart[row];
+
+    if(_hasHistory[row])
+    {
+        user.previousLeftPart = _previousLeftPart[row];
+        user.previousRightPart = _previousRightPart[row];
+    }
+
+    user.rotation = _rotation[row];
+    user.walkSpeed = _walkSpeed[row];
+    user.numberOfFramesWithoutMove = _framesWithoutMove[row];
+    if(!_history[row].isEmpty())
+    {
+        user.rotationRate = _history[row].last().rotationRate;
+        user.walkSpeedRate = _history[row].last().speedRate;
+    }
+    return user;
+}
+
+QString UserTable::filterReport() const
+{
+    return _rotationStats.report("Rotation", "deg") + "\n" + _speedStats.report("Walk speed", "cm/s") + "\n"
+            + _rotationPredictionStats.report("Rotation", "deg") + "\n"
+            + _speedPredictionStats.report("Walk speed", "cm/s");
+}
+
+// Private
+void UserTable::moveRow(const int from, const int to)
+{
+    _id[to] = _id[from];
+    _seen[to] = _seen[from];
+    _hasPose[to] = _hasPose[from];
+    _hasHistory[to] = _hasHistory[from];
+    _updated[to] = _updated[from];
+
+    _torso[to] = _torso[from];
+    _leftPart[to] = _leftPart[from];
+    _rightPart[to] = _rightPart[from];
+    _timestamp[to] = _timestamp[from];
+
+    _previousLeftPart[to] = _previousLeftPart[from];
+    _previousRightPart[to] = _previousRightPart[from];
+    _previousTimestamp[to] = _previousTimestamp[from];
+
+    _rotation[to] = _rotation[from];
+    _walkSpeed[to] = _walkSpeed[from];
+    _framesWithoutMove[to] = _framesWithoutMove[from];
+
+    _rotationFilter[to] = _rotationFilter[from];
+    _speedFilter[to] = _speedFilter[from];
+    _history[to] = _history[from];
+    _rawRotation[to] = _rawRotation[from];
+    _rawSpeed[to] = _rawSpeed[from];
+}
@@ -0,0 +1,124 @@
+/*
+ * This file is part of VRController.
+ * Copyright (c) 2015 Fabien Caylus <toutjuste13@gmail.com>
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef USERTABLE_H
+#define USERTABLE_H
+
+#include <ni/XnTypes.h>
+#include <cstdint>
+
+#include "openniutil.h"
+#include "posefilter.h"
+#include "motionpredictor.h"
+
+// Maximum number of users returned by the user generator
+#define MAX_DETECTED_USERS 15
+
+// Table of the tracked users, stored as a structure of arrays.
+// Rows are packed: a user keeps its row while tracked and the last row
+// is moved in the hole when a user is lost. Nothing is allocated.
+//
+// Each frame:
+// - call beginFrame()
+// - call setPose() for each tracked user (using rowForUser())
+// - call endFrame() to forget users not seen in this frame
+// - call computeMotion() to update the rotation and the walk speed of all users
+//
+// The rotation and the walk speed are smoothed with the timestamps of the sensor,
+// so the result doesn't depend on the frame rate.
+// Their recent history is kept to extrapolate them (see predictRotation()).
+class UserTable
+{
+    public:
+        UserTable();
+
+        // Forget all users, the measures of the filters are kept
+        void clear();
+
+        void beginFrame();
+        // Return the row of the user, a new row is used if the user is unknown
+        // Return -1 if the table is full
+        int rowForUser(const XnUserID id);
+        // Set the joints and the timestamp of the current frame
+        // The previous ones are kept as history
+        // A pose with the same timestamp as the previous one is ignored
+        void setPose(const int row, const OpenNIUtil::User& pose);
+        void endFrame();
+
+        // Compute the rotation and the walk speed for each user
+        // The values predicted this horizon (in µs) earlier are compared to the new ones
+        void computeMotion(const FilterSettings& rotationFilter, const FilterSettings& speedFilter,
+                           const int64_t predictionHorizon);
+
+        // Number of users in the table
+        int count() const;
+        // Return -1 if the user is not in the table
+        int rowOf(const XnUserID id) const;
+        XnUserID idAt(const int row) const;
+
+        // Return all informations about the user at the specified row
+        OpenNIUtil::User userAt(const int row) const;
+
+        // Measures of the filters and of the predictions since the creation of the table
+        QString filterReport() const;
+
+    private:
+        void moveRow(const int from, const int to);
+
+        int _count = 0;
+
+        XnUserID _id[MAX_TRACKED_USERS];
+        bool _seen[MAX_TRACKED_USERS];
+        // True if setPose() was called at least once for this user
+        bool _hasPose[MAX_TRACKED_USERS];
+        // True if the previous frame contains data for this user
+        bool _hasHistory[MAX_TRACKED_USERS];
+        // True if the pose changed in this frame
+        bool _updated[MAX_TRACKED_USERS];
+
+        // Current joints
+        OpenNIUtil::Joint _torso[MAX_TRACKED_USERS];
+        OpenNIUtil::BodyPart _leftPart[MAX_TRACKED_USERS];
+        OpenNIUtil::BodyPart _rightPart[MAX_TRACKED_USERS];
+        int64_t _timestamp[MAX_TRACKED_USERS];
+
+        // History
+        OpenNIUtil::BodyPart _previousLeftPart[MAX_TRACKED_USERS];
+        OpenNIUtil::BodyPart _previousRightPart[MAX_TRACKED_USERS];
+        int64_t _previousTimestamp[MAX_TRACKED_USERS];
+
+        // Computed values
+        int _rotation[MAX_TRACKED_USERS];
+        int _walkSpeed[MAX_TRACKED_USERS];
+        int _framesWithoutMove[MAX_TRACKED_USERS];
+
+        // Filters, the raw values are -1 if unknown
+        ScalarFilter _rotationFilter[MAX_TRACKED_USERS];
+        ScalarFilter _speedFilter[MAX_TRACKED_USERS];
+        float _rawRotation[MAX_TRACKED_USERS];
+        float _rawSpeed[MAX_TRACKED_USERS];
+
+        MotionHistory _history[MAX_TRACKED_USERS];
+
+        FilterStats _rotationStats;
+        FilterStats _speedStats;
+        PredictionStats _rotationPredictionStats;
+        PredictionStats _speedPredictionStats;
+};
+
+#endif // USERTABLE_H